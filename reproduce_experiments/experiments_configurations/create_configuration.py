@@ -237,6 +237,28 @@ def figure12(tsvname):
     for datasetSize in datasetSizes:
         utils.UaR_to_tsv(tsv2, 10 ** datasetSize, "sip", 8, 1)
 
+# The fal and cfal shapes of figure 9, searched with the Interpolation-Binary
+# Search hybrid and the algorithms it combines. The -tail entries report the
+# p99 latency of the lookups of each subset instead of their mean.
+def hybrid_fal(tsvname):
+    print("Configuring experiment : " + tsvname)
+    shapes = {"05": 0.5, "105": 1.05, "125": 1.25, "15": 1.5}
+    for name in shapes:
+        utils.rm_tsv(tsvname + "_" + name + "_fal.tsv")
+        utils.rm_tsv(tsvname + "_" + name + "_cfal.tsv")
+
+    datasetSizes = [3, 4, 5, 6, 7]
+    if fullConfiguration():
+        datasetSizes = [3, 4, 5, 6, 7, 8, 9]
+
+    for algorithm in ["ibs", "sip", "bs", "ibs-tail", "sip-tail", "bs-tail"]:
+        for datasetSize in datasetSizes:
+            for name, shape in shapes.items():
+                utils.fal_to_tsv(tsvname + "_" + name + "_fal.tsv", algorithm,
+                                 8, 1, shape, 10 ** datasetSize)
+                utils.cfal_to_tsv(tsvname + "_" + name + "_cfal.tsv",
+                                  algorithm, 8, 1, shape, 10 ** datasetSize)
+
 ################################################
 
 
@@ -253,3 +275,4 @@ Section56_SIP_UAR("section56_SIP_UAR")
 Section56_SIP_FB("section56_SIP_FB")
 Section56_TIP("section56_TIP")
 Section56_TIP_FREQ("section56_TIP_Freq")
+hybrid_fal("hybrid")
@@ -95,4 +95,13 @@ run("section56_TIP_105_cfal.tsv")
 run("section56_TIP_125_cfal.tsv")
 run("section56_TIP_15_cfal.tsv")
 run("section56_TIP_Freq.tsv")
+
+run("hybrid_05_fal.tsv")
+run("hybrid_105_fal.tsv")
+run("hybrid_125_fal.tsv")
+run("hybrid_15_fal.tsv")
+run("hybrid_05_cfal.tsv")
+run("hybrid_105_cfal.tsv")
+run("hybrid_125_cfal.tsv")
+run("hybrid_15_cfal.tsv")
 run_metadata("fig12.tsv")
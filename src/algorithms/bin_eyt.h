@@ -3,52 +3,187 @@
 
 // The search methods proposed in https://arxiv.org/pdf/1509.05053.pdf
 
+#include "../index_file.h"
+
+#include <omp.h>
+
 template <int record_bytes = 8, bool prefetch = false,
-    typename Index = unsigned long>
+    typename Index = unsigned long, class Stats = NoStats>
 class b_eyt {
   using Vector = PaddedVector<record_bytes>;
   using Linear = LinearUnroll<Vector>;
+  using Record = typename Vector::Record;
 
   const Vector A;
+  [[no_unique_address]] Stats lookup_stats;
   static const Index multiplier = 64 / sizeof(record_bytes);
   static const Index offset = multiplier + multiplier / 2;
 
-  template <typename T, typename ForwardIterator>
-  ForwardIterator copy_data(ForwardIterator a0, size_t i, T &out) {
+  // Fills the subtree of node i in order with the records of rank j onward,
+  // returns the rank after the last one used.
+  template <class Source>
+  static Index copy_data(const Source &source, Index j, size_t i, Vector &out) {
     if (i >= out.size())
-      return a0;
+      return j;
 
     // visit left child
-    a0 = copy_data(a0, 2 * i + 1, out);
+    j = copy_data(source, j, 2 * i + 1, out);
 
-    // put data at the root
-    out[i] = *a0++;
+    // put data at the root, payload included
+    out.record(i) = source(j++);
 
     // visit right child
-    a0 = copy_data(a0, 2 * i + 2, out);
+    j = copy_data(source, j, 2 * i + 2, out);
 
-    return a0;
+    return j;
   }
 
-  template <typename T> T eytzinger_array(T in) {
-    T rv(in.size());
-    copy_data(in.begin(), 0, rv);
-    return rv;
+  // Position in sorted order of node i of an Eytzinger array of size n, n for
+  // the end. Node i is compared to the perfect tree of the same height, which
+  // differs only by the missing nodes at the right end of the last level.
+  static Index rank(Index i, Index n) {
+    if (i >= n)
+      return n;
+    const Index k = i + 1;
+    const int depth = 63 - __builtin_clzl(k), height = 63 - __builtin_clzl(n);
+    const Index last_level = n - ((1UL << height) - 1);
+    const Index pos = k - (1UL << depth);
+    if (depth == height)
+      return 2 * pos;
+    const Index leaves_before = (2 * pos + 1) << (height - depth - 1);
+    const Index perfect_rank = ((2 * pos + 1) << (height - depth)) - 1;
+    return perfect_rank -
+           (leaves_before > last_level ? leaves_before - last_level : 0);
   }
 
- public:
-  b_eyt(const Vector &_a) : A(eytzinger_array(_a)) {}
-
-  // Branch-free code with or without prefetching
-  __attribute__((always_inline)) Key search(const Key x) {
-    Index i = 0;
+  // Descends from node i.
+  __attribute__((always_inline)) Index search(Index i, const Key x) {
     while (i < A.size()) {
       if (prefetch)
         __builtin_prefetch(&A[0] + (multiplier * i + offset));
+      lookup_stats.probe(Probe::Bisection, &A[i]);
       i = (x <= A[i]) ? (2 * i + 1) : (2 * i + 2);
     }
     Index j = (i + 1) >> __builtin_ffs(~(i + 1));
-    return A[j - 1];
+    return j - 1;
+  }
+
+  // source(j) is the record of rank j. The nodes of the top levels are placed
+  // by their rank, then the subtrees below them are filled in order in
+  // parallel, each with sequential reads of its range of ranks.
+  template <class Source>
+  static Vector eytzinger_array(const Source &source, const Index n,
+                                const int n_thds) {
+    Vector out(n);
+    // a few subtrees per thread, for balance
+    const Index top = n_thds > 1 ? (1UL << ceil_lg(8U * n_thds)) - 1 : 0;
+    for (Index i = 0; i < std::min(top, n); i++)
+      out.record(i) = source(rank(i, n));
+#pragma omp parallel for num_threads(n_thds) schedule(dynamic, 1)
+    for (Index r = top; r < std::min(2 * top + 1, n); r++) {
+      Index leftmost = r;
+      while (2 * leftmost + 1 < n)
+        leftmost = 2 * leftmost + 1;
+      copy_data(source, rank(leftmost, n), r, out);
+    }
+    return out;
+  }
+
+ public:
+  // The layout is built by n_thds threads, sequentially by default.
+  b_eyt(const Vector &_a, const int n_thds = 1) : A(layout(_a, n_thds)) {}
+
+  // From n sorted keys, e.g. of a MappedKeys, the payloads are generated.
+  b_eyt(const Key *keys, const Index n, const int n_thds = 1)
+      : A(layout(keys, n, n_thds)) {}
+
+  static constexpr char index_name[] = "b-eyt";
+
+  // Loads an index saved by save(): the records of the file are the layout,
+  // searched where they are mapped.
+  b_eyt(const IndexFile<record_bytes> &file) : A(file.records()) {}
+
+  // Writes the layout to an index file, there are no other constants.
+  void save(const std::string &path) const {
+    typename IndexFile<record_bytes>::Writer out(path, index_name, A);
+  }
+
+  // The Eytzinger layout of sorted records, built by n_thds threads.
+  static Vector layout(const Vector &in, const int n_thds) {
+    return eytzinger_array(
+        [&](Index j) -> const Record & { return in.record(j); }, in.size(),
+        n_thds);
+  }
+
+  static Vector layout(const Key *keys, const Index n, const int n_thds) {
+    return eytzinger_array([&](Index j) { return Record(keys[j]); }, n,
+                           n_thds);
+  }
+
+  // The same layout built by a sequential in-order traversal.
+  static Vector layout_recursive(const Vector &in) {
+    Vector out(in.size());
+    copy_data([&](Index j) -> const Record & { return in.record(j); }, 0, 0,
+              out);
+    return out;
+  }
+
+  // Branch-free code with or without prefetching, returns the position of the
+  // first key >= x in A, or Index(-1) if there is none.
+  __attribute__((always_inline)) Index search(const Key x) {
+    return search(0, x);
+  }
+
+  // Finger search from node hint, such as the result of a previous search.
+  // Climbs to the lowest ancestor of hint whose subtree can hold the answer,
+  // then descends from it.
+  __attribute__((always_inline)) Index search_from(Index hint, const Key x) {
+    if (hint >= A.size())
+      return search(x);
+    for (; hint > 0; hint = (hint - 1) / 2) {
+      // The keys of the subtree lie between its nearest ancestors to the left
+      // and to the right.
+      bool has_left = false, has_right = false, holds_x = true;
+      for (Index c = hint; c > 0 && !(has_left && has_right);
+           c = (c - 1) / 2) {
+        Index parent = (c - 1) / 2;
+        if (c % 2 == 1 && !has_right) {
+          has_right = true;
+          lookup_stats.touch(&A[parent]);
+          holds_x = holds_x && x <= A[parent];
+        } else if (c % 2 == 0 && !has_left) {
+          has_left = true;
+          lookup_stats.touch(&A[parent]);
+          holds_x = holds_x && A[parent] < x;
+        }
+      }
+      if (holds_x)
+        break;
+    }
+    return search(hint, x);
+  }
+
+  const Vector &records() const { return A; }
+
+  // The same search instrumented with the policy S, see lookup_stats.h.
+  template <class S> using with_stats = b_eyt<record_bytes, prefetch, Index, S>;
+  Stats &stats() { return lookup_stats; }
+
+  // Bytes held besides the records searched, the Eytzinger copy of them.
+  size_t aux_bytes() const { return sizeof(*this) + A.bytes(); }
+
+  // Unlike the other algorithms the range is of positions in sorted order,
+  // the records themselves are in the Eytzinger order of A.
+  std::pair<Index, Index> equal_range(const Key x) {
+    Index lower = search(x);
+    Index upper =
+        x == std::numeric_limits<Key>::max() ? Index(-1) : search(x + 1);
+    return {rank(lower, A.size()), rank(upper, A.size())};
+  }
+
+  Index count(const Key x) {
+    auto range = equal_range(x);
+    return range.second - range.first;
   }
 };
 
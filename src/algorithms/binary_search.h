@@ -4,7 +4,10 @@
 #include <assert.h>
 #include <cinttypes>
 
+#include "coro.h"
+#include "gallop.h"
 #include "linear_search.h"
+#include "../index_file.h"
 #include "../padded_vector.h"
 #include "../util.h"
 
@@ -71,13 +74,19 @@ public:
 
 template <int record_bytes = 8, bool RETURN_EARLY = false, bool TEST_EQ = false,
           bool FOR = true, bool POW_2 = false, int MIN_EQ_SZ = 32,
-          typename Index = unsigned long>
+          typename Index = unsigned long, class Stats = NoStats>
 class Binary {
   using Vector = PaddedVector<record_bytes>;
   using Linear = LinearUnroll<Vector>;
 
   const Vector &A;
   int lg_v, lg_min;
+  [[no_unique_address]] Stats lookup_stats;
+
+  // The loop counts, saved in an IndexFile.
+  struct Saved {
+    int lg_v, lg_min;
+  };
 
 public:
   Binary(const Vector &_a) : A(_a) {
@@ -89,19 +98,27 @@ public:
     }
   }
 
-  __attribute__((always_inline)) Key search(const Key x) {
-    Index n = A.size();
-    Index left = 0L;
-    if (POW_2) {
-      Index mid = n - (1UL << (lg_v - 1));
-      left = A[mid] <= x ? mid : left;
-      n -= mid;
-    }
+  static constexpr char index_name[] = "bs";
+
+  // Loads an index saved by save(), searching the records of the file.
+  Binary(const IndexFile<record_bytes> &file)
+      : A(file.records()),
+        lg_v(file.template section<Saved>(index_name).lg_v),
+        lg_min(file.template section<Saved>(index_name).lg_min) {}
+
+  void save(const std::string &path) const {
+    typename IndexFile<record_bytes>::Writer out(path, index_name, A);
+    out.section(index_name, Saved{lg_v, lg_min});
+  }
+
+// The search, shared by search() and search_coro(). PROBE(p) comes before
+// each probe of the record at p and RETURN returns the result.
 // TODO how to set unroll = 4 if MIN_EQ_SZ > 1?, else 8?
-#define LOOP                                                                   \
+#define LOOP(PROBE, RETURN)                                                    \
   assert(left + n == A.size() || A[left + n] > x);                             \
   assert(A[left] <= x);                                                        \
   Index half = n / 2;                                                          \
+  PROBE(&A[left + half]);                                                      \
   if (TEST_EQ) {                                                               \
     if (x < A[left + half]) {                                                  \
       n = half;                                                                \
@@ -110,7 +127,7 @@ public:
       n = n - half - 1;                                                        \
     } else {                                                                   \
       if (RETURN_EARLY)                                                        \
-        return A[left + half];                                                 \
+        RETURN left + half;                                                    \
       left += half;                                                            \
       if (FOR)                                                                 \
         i = lg_min;                                                            \
@@ -124,25 +141,192 @@ public:
     else                                                                       \
       n -= half;                                                               \
   }
-    if (MIN_EQ_SZ == 1) {
-#pragma unroll(8)
-      for (int i = POW_2 ? 1 : 0; FOR ? i < lg_min : n > MIN_EQ_SZ; i++) {
-        LOOP
-      }
-    } else {
+#define BS_SEARCH(PROBE, RETURN)                                               \
+  Index n = A.size();                                                          \
+  Index left = 0L;                                                             \
+  if (POW_2) {                                                                 \
+    Index mid = n - (1UL << (lg_v - 1));                                       \
+    PROBE(&A[mid]);                                                            \
+    left = A[mid] <= x ? mid : left;                                           \
+    n -= mid;                                                                  \
+  }                                                                            \
+  if (MIN_EQ_SZ == 1) {                                                        \
+    _Pragma("unroll(8)")                                                       \
+    for (int i = POW_2 ? 1 : 0; FOR ? i < lg_min : n > MIN_EQ_SZ; i++) {       \
+      LOOP(PROBE, RETURN)                                                      \
+    }                                                                          \
+  } else {                                                                     \
+    _Pragma("unroll(4)")                                                       \
+    for (int i = POW_2 ? 1 : 0; FOR ? i < lg_min : n > MIN_EQ_SZ; i++) {       \
+      LOOP(PROBE, RETURN)                                                      \
+    }                                                                          \
+  }                                                                            \
+  if (MIN_EQ_SZ == 1)                                                          \
+    RETURN left;                                                               \
+                                                                               \
+  Index guess = left + n / 2;                                                  \
+  PROBE(&A[guess]);                                                            \
+  if (A[guess] < x)                                                            \
+    RETURN Linear::forward(A, guess + 1, x, lookup_stats);                     \
+  else                                                                         \
+    RETURN Linear::reverse(A, guess, x, lookup_stats);
+#define BS_PROBE(p) lookup_stats.probe(Probe::Bisection, p)
+
+  __attribute__((always_inline)) Index search(const Key x) {
+    BS_SEARCH(BS_PROBE, return)
+  }
+
+#ifdef CORO_SEARCH
+  // search() as a coroutine, yields before each probe.
+#define BS_PROBE_CORO(p) (BS_PROBE(p), co_await Prefetch{p})
+  SearchTask search_coro(const Key x) {
+    BS_SEARCH(BS_PROBE_CORO, co_return)
+  }
+#endif
+
+  // Finger search, gallops from hint, such as the result of a previous
+  // search.
+  __attribute__((always_inline)) Index search_from(const Index hint,
+                                                   const Key x) {
+    return Gallop<Vector>::lower_bound(A, hint, x);
+  }
+
+  const Vector &records() const { return A; }
+
+  // The same search instrumented with the policy S, see lookup_stats.h.
+  template <class S>
+  using with_stats = Binary<record_bytes, RETURN_EARLY, TEST_EQ, FOR, POW_2,
+                            MIN_EQ_SZ, Index, S>;
+  Stats &stats() { return lookup_stats; }
+
+  // Bytes held besides the records searched.
+  size_t aux_bytes() const { return sizeof(*this); }
+
+  // The positions of the first and one past the last record with key x.
+  std::pair<Index, Index> equal_range(const Key x) {
+    return Gallop<Vector>::equal_range(A, search(x), x);
+  }
+
+  Index count(const Key x) {
+    auto range = equal_range(x);
+    return range.second - range.first;
+  }
+};
+#undef LOOP
+#undef BS_SEARCH
+#undef BS_PROBE
+#undef BS_PROBE_CORO
+
+// Branch-free Binary Search (TEST_EQ = false) that prefetches the records it
+// may probe `levels` steps ahead: the 2^levels candidate midpoints reachable
+// from the current interval. The prefetches use the address of the record, so
+// they hit the right cache line for every record size. Keeps the sorted
+// layout, unlike b_eyt which needs a copy of the array.
+template <int record_bytes = 8, int levels = 1, int MIN_EQ_SZ = 32,
+          class Stats = NoStats>
+class BinaryPrefetch {
+  using Vector = PaddedVector<record_bytes>;
+  using Linear = LinearUnroll<Vector>;
+
+  const Vector &A;
+  int lg_min;
+  [[no_unique_address]] Stats lookup_stats;
+
+  // Prefetches the candidate midpoints of the step whose interval size is
+  // n[depth], reachable from left by the steps with interval sizes n[0, depth).
+  __attribute__((always_inline)) void prefetch(const Index left,
+                                               const Index *n,
+                                               const int depth) const {
+    for (int c = 0; c < (1 << depth); c++) {
+      Index offset = n[depth] / 2;
+      for (int j = 0; j < depth; j++)
+        if (c >> j & 1)
+          offset += n[j] / 2;
+      __builtin_prefetch(&A[left + offset]);
+    }
+  }
+
+  // The loop count, saved in an IndexFile.
+  struct Saved {
+    int lg_min;
+  };
+
+ public:
+  BinaryPrefetch(const Vector &_a) : A(_a) {
+    static_assert(levels >= 1 && levels <= 3, "prefetch 1 to 3 levels ahead");
+    lg_min = 0;
+    for (auto n = A.size(); n > 1; n -= (n / 2))
+      if (n > MIN_EQ_SZ)
+        lg_min++;
+  }
+
+  // The records are sorted as for bs, the file does not depend on levels.
+  static constexpr char index_name[] = "bs-p";
+
+  // Loads an index saved by save(), searching the records of the file.
+  BinaryPrefetch(const IndexFile<record_bytes> &file)
+      : A(file.records()),
+        lg_min(file.template section<Saved>(index_name).lg_min) {}
+
+  void save(const std::string &path) const {
+    typename IndexFile<record_bytes>::Writer out(path, index_name, A);
+    out.section(index_name, Saved{lg_min});
+  }
+
+  __attribute__((always_inline)) Index search(const Key x) {
+    // n[j] is the interval size j steps ahead
+    Index n[levels + 1];
+    n[0] = A.size();
+    for (int j = 1; j <= levels; j++)
+      n[j] = n[j - 1] - n[j - 1] / 2;
+    Index left = 0;
+    for (int depth = 1; depth < levels; depth++)
+      prefetch(left, n, depth);
+
 #pragma unroll(4)
-      for (int i = POW_2 ? 1 : 0; FOR ? i < lg_min : n > MIN_EQ_SZ; i++) {
-        LOOP
-      }
+    for (int i = 0; i < lg_min; i++) {
+      prefetch(left, n, levels);
+      Index half = n[0] / 2;
+      lookup_stats.probe(Probe::Bisection, &A[left + half]);
+      left = A[left + half] <= x ? left + half : left;
+      for (int j = 0; j < levels; j++)
+        n[j] = n[j + 1];
+      n[levels] -= n[levels] / 2;
     }
-    if (MIN_EQ_SZ == 1)
-      return A[left];
 
-    Index guess = left + n / 2;
+    Index guess = left + n[0] / 2;
+    lookup_stats.probe(Probe::Bisection, &A[guess]);
     if (A[guess] < x)
-      return A[Linear::forward(A, guess + 1, x)];
+      return Linear::forward(A, guess + 1, x, lookup_stats);
     else
-      return A[Linear::reverse(A, guess, x)];
+      return Linear::reverse(A, guess, x, lookup_stats);
+  }
+
+  // Finger search, gallops from hint, such as the result of a previous
+  // search.
+  __attribute__((always_inline)) Index search_from(const Index hint,
+                                                   const Key x) {
+    return Gallop<Vector>::lower_bound(A, hint, x);
+  }
+
+  const Vector &records() const { return A; }
+
+  // The same search instrumented with the policy S, see lookup_stats.h.
+  template <class S>
+  using with_stats = BinaryPrefetch<record_bytes, levels, MIN_EQ_SZ, S>;
+  Stats &stats() { return lookup_stats; }
+
+  // Bytes held besides the records searched.
+  size_t aux_bytes() const { return sizeof(*this); }
+
+  // The positions of the first and one past the last record with key x.
+  std::pair<Index, Index> equal_range(const Key x) {
+    return Gallop<Vector>::equal_range(A, search(x), x);
+  }
+
+  Index count(const Key x) {
+    auto range = equal_range(x);
+    return range.second - range.first;
   }
 };
 
@@ -0,0 +1,140 @@
+#ifndef BINARY_SIMD_H
+#define BINARY_SIMD_H
+
+#include "linear_search.h"
+#include "lookup_stats.h"
+#include "../isa.h"
+#include "../padded_vector.h"
+#include "../util.h"
+
+#include <algorithm>
+
+#include <x86intrin.h>
+
+// Branch-free binary search of several keys in lockstep, one key per SIMD
+// lane: 4 with AVX2 and 8 with AVX-512. As in Binary (TEST_EQ = false) the
+// size of the search interval does not depend on the comparisons, so all the
+// lanes share it and the lg_min trip count. Each step gathers the middle
+// records of all the lanes and moves the left bounds with a mask. The last
+// MIN_EQ_SZ records of each lane are searched linearly, and keys that do not
+// fill a vector are searched one at a time.
+// The width is that of selected_isa() (isa.h), capped at construction.
+// A lane probes the same records as search() of its key, which alone reports
+// them to Stats: the lanes of a batch are not separate lookups.
+
+enum class SimdWidth { Scalar = 1, AVX2 = 4, AVX512 = 8 };
+
+template <int record_bytes = 8, int MIN_EQ_SZ = 32, class Stats = NoStats>
+class BinarySimd {
+  using Vector = PaddedVector<record_bytes>;
+  using Linear = LinearUnroll<Vector>;
+  // distance between keys, in keys
+  static constexpr int stride_shift = __builtin_ctz(record_bytes / sizeof(Key));
+
+  const Vector &A;
+  int lg_min;
+  SimdWidth width;
+  [[no_unique_address]] Stats lookup_stats;
+
+  template <class S>
+  __attribute__((always_inline)) Index linear(Index left, Index n, const Key x,
+                                              S &&stats) const {
+    Index guess = left + n / 2;
+    stats.probe(Probe::Bisection, &A[guess]);
+    if (A[guess] < x)
+      return Linear::forward(A, guess + 1, x, stats);
+    else
+      return Linear::reverse(A, guess, x, stats);
+  }
+
+  ISA_TARGET_AVX2 void search4(const Key *x, Index *out) {
+    const long long *base = (const long long *)&A[0];
+    const __m256i keys = _mm256_loadu_si256((const __m256i *)x);
+    __m256i left = _mm256_setzero_si256();
+    Index n = A.size();
+    for (int i = 0; i < lg_min; i++) {
+      Index half = n / 2;
+      __m256i mid = _mm256_add_epi64(left, _mm256_set1_epi64x(half));
+      __m256i probe = _mm256_i64gather_epi64(
+          base, _mm256_slli_epi64(mid, stride_shift), sizeof(Key));
+      // left = probe <= key ? mid : left
+      left = _mm256_blendv_epi8(mid, left, _mm256_cmpgt_epi64(probe, keys));
+      n -= half;
+    }
+    alignas(32) Index lefts[4];
+    _mm256_store_si256((__m256i *)lefts, left);
+    for (int l = 0; l < 4; l++)
+      out[l] = linear(lefts[l], n, x[l], NoStats());
+  }
+
+  ISA_TARGET_AVX512 void search8(const Key *x, Index *out) {
+    const long long *base = (const long long *)&A[0];
+    const __m512i keys = _mm512_loadu_si512(x);
+    __m512i left = _mm512_setzero_si512();
+    Index n = A.size();
+    for (int i = 0; i < lg_min; i++) {
+      Index half = n / 2;
+      __m512i mid = _mm512_add_epi64(left, _mm512_set1_epi64(half));
+      __m512i probe = _mm512_i64gather_epi64(
+          _mm512_slli_epi64(mid, stride_shift), base, sizeof(Key));
+      left = _mm512_mask_blend_epi64(_mm512_cmple_epi64_mask(probe, keys),
+                                     left, mid);
+      n -= half;
+    }
+    alignas(64) Index lefts[8];
+    _mm512_store_si512(lefts, left);
+    for (int l = 0; l < 8; l++)
+      out[l] = linear(lefts[l], n, x[l], NoStats());
+  }
+
+ public:
+  BinarySimd(const Vector &_a, SimdWidth max_width = SimdWidth::AVX512)
+      : A(_a) {
+    lg_min = 0;
+    for (auto n = A.size(); n > 1; n -= (n / 2))
+      if (n > MIN_EQ_SZ)
+        lg_min++;
+    const Isa isa = selected_isa();
+    width = std::min(max_width, isa == Isa::AVX512 ? SimdWidth::AVX512
+                                : isa == Isa::AVX2 ? SimdWidth::AVX2
+                                                   : SimdWidth::Scalar);
+  }
+
+  __attribute__((always_inline)) Index search(const Key x) {
+    Index n = A.size();
+    Index left = 0;
+    for (int i = 0; i < lg_min; i++) {
+      Index half = n / 2;
+      lookup_stats.probe(Probe::Bisection, &A[left + half]);
+      left = A[left + half] <= x ? left + half : left;
+      n -= half;
+    }
+    return linear(left, n, x, lookup_stats);
+  }
+
+  // Writes the position of the record of x[i] to out[i].
+  void search_batch(const Key *x, const long n, Index *out) {
+    long i = 0;
+    if (width == SimdWidth::AVX512)
+      for (; i + 8 <= n; i += 8)
+        search8(x + i, out + i);
+    else if (width == SimdWidth::AVX2)
+      for (; i + 4 <= n; i += 4)
+        search4(x + i, out + i);
+    for (; i < n; i++)
+      out[i] = search(x[i]);
+  }
+
+  SimdWidth simd_width() const { return width; }
+
+  const Vector &records() const { return A; }
+
+  // The same search instrumented with the policy S, see lookup_stats.h.
+  template <class S> using with_stats = BinarySimd<record_bytes, MIN_EQ_SZ, S>;
+  Stats &stats() { return lookup_stats; }
+
+  // Bytes held besides the records searched.
+  size_t aux_bytes() const { return sizeof(*this); }
+};
+
+#endif //BINARY_SIMD_H
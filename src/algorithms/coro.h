@@ -0,0 +1,158 @@
+#ifndef CORO_H
+#define CORO_H
+
+// Interleaved execution of lookups with C++20 coroutines. A search loop
+// written as a coroutine returning SearchTask does `co_await Prefetch{address}`
+// before each probe of the array, which prefetches the probe and yields.
+// interleave() keeps K lookups in flight and resumes them round robin, so the
+// cache misses of K lookups overlap.
+// Needs C++20, the coroutine versions of the algorithms are left out of
+// builds without coroutine support.
+
+#if defined(__cpp_impl_coroutine)
+#define CORO_SEARCH 1
+
+#include "../util.h"
+
+#include <coroutine>
+#include <exception>
+#include <new>
+
+// Recycles the coroutine frames of a thread, lookups would otherwise pay for
+// a call to malloc each. Only frames of the size released first are kept.
+class FramePool {
+  struct Block {
+    Block *next;
+  };
+  struct FreeList {
+    Block *head;
+    size_t block_size;
+    FreeList() : head(nullptr), block_size(0) {}
+    ~FreeList() {
+      while (head != nullptr) {
+        Block *b = head;
+        head = head->next;
+        ::operator delete(b);
+      }
+    }
+  };
+  static inline thread_local FreeList free_list;
+
+ public:
+  static void *allocate(size_t size) {
+    if (size == free_list.block_size && free_list.head != nullptr) {
+      Block *b = free_list.head;
+      free_list.head = b->next;
+      return b;
+    }
+    return ::operator new(size);
+  }
+
+  static void release(void *p, size_t size) {
+    if (free_list.block_size == 0)
+      free_list.block_size = size;
+    if (size != free_list.block_size) {
+      ::operator delete(p);
+      return;
+    }
+    Block *b = static_cast<Block *>(p);
+    b->next = free_list.head;
+    free_list.head = b;
+  }
+};
+
+// One lookup, its result is the position of the record found.
+class SearchTask {
+ public:
+  struct promise_type {
+    Index result;
+
+    SearchTask get_return_object() {
+      return SearchTask(Handle::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_value(const Index r) { result = r; }
+    void unhandled_exception() { std::terminate(); }
+
+    static void *operator new(size_t size) { return FramePool::allocate(size); }
+    static void operator delete(void *p, size_t size) {
+      FramePool::release(p, size);
+    }
+  };
+  using Handle = std::coroutine_handle<promise_type>;
+
+  SearchTask() = default;
+  explicit SearchTask(Handle h) : h(h) {}
+  SearchTask(SearchTask &&t) noexcept : h(t.h) { t.h = nullptr; }
+  SearchTask &operator=(SearchTask &&t) noexcept {
+    if (h)
+      h.destroy();
+    h = t.h;
+    t.h = nullptr;
+    return *this;
+  }
+  ~SearchTask() {
+    if (h)
+      h.destroy();
+  }
+
+  explicit operator bool() const { return (bool)h; }
+  bool done() const { return h.done(); }
+  void resume() const { h.resume(); }
+  Index result() const { return h.promise().result; }
+
+ private:
+  Handle h;
+};
+
+// Prefetches the cache line of a probe and yields to the scheduler.
+struct Prefetch {
+  const void *address;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<>) const noexcept {
+    __builtin_prefetch(address);
+  }
+  void await_resume() const noexcept {}
+};
+
+constexpr int max_interleave = 64;
+
+// Searches keys[0, n) with k lookups in flight, start(key) creates the
+// SearchTask of a key. Writes the result of keys[i] to out[i].
+template <class Start>
+void interleave(const Key *keys, const long n, Index *out, int k,
+                Start &&start) {
+  SearchTask tasks[max_interleave];
+  long query[max_interleave];
+  k = std::min(k, max_interleave);
+
+  long next = 0;
+  int active = 0;
+  for (; active < k && next < n; active++, next++) {
+    tasks[active] = start(keys[next]);
+    query[active] = next;
+  }
+  while (active > 0) {
+    for (int s = 0; s < k; s++) {
+      if (!tasks[s])
+        continue;
+      tasks[s].resume();
+      if (!tasks[s].done())
+        continue;
+      out[query[s]] = tasks[s].result();
+      if (next < n) {
+        tasks[s] = start(keys[next]);
+        query[s] = next++;
+      } else {
+        tasks[s] = SearchTask();
+        active--;
+      }
+    }
+  }
+}
+
+#endif // __cpp_impl_coroutine
+
+#endif //CORO_H
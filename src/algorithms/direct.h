@@ -0,0 +1,60 @@
+#ifndef DIRECT_H
+#define DIRECT_H
+
+#include "linear_search.h"
+#include "../padded_vector.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <cstdint>
+
+// Direct addressing of keys about as dense as their positions, such as
+// sequential IDs: the record of key x is near position x - min, no
+// interpolation needed. It applies when every key is within max_off
+// positions of key - min, checked at construction with a scan of the
+// records that only runs when the key span allows it. The linear search
+// from x - min then verifies and corrects the position in at most max_off
+// steps.
+template <class Vector, int max_off = 8> class DirectAddress {
+  const Key first;
+  const bool dense;
+
+  static bool is_dense(const Vector &data) {
+    const uint64_t n = data.size();
+    if (n == 0 ||
+        (uint64_t)data.back() - (uint64_t)data[0] > n - 1 + max_off)
+      return false;
+    // the span is small, the offsets fit in an Index
+    for (Index i = 0; i < (Index)n; i++) {
+      const Index off = (Index)((uint64_t)data[i] - (uint64_t)data[0]) - i;
+      if (off < -max_off || off > max_off)
+        return false;
+    }
+    return true;
+  }
+
+ public:
+  DirectAddress(const Vector &data)
+      : first(data.size() == 0 ? 0 : data[0]), dense(is_dense(data)) {}
+
+  bool applies() const { return __builtin_expect(dense, 0); }
+
+  // Returns a position of x, or of the first key > x if x is absent. Kept
+  // out of line, it would bloat the inlined search it is a branch of.
+  template <class Stats>
+  __attribute__((noinline)) Index search(const Vector &data, const Key x,
+                                         Stats &stats) const {
+    using Linear = LinearUnroll<Vector>;
+    const Index next =
+        x <= first ? 0
+                   : (Index)std::min<uint64_t>((uint64_t)x - (uint64_t)first,
+                                               data.size() - 1);
+    stats.probe(Probe::Interpolation, &data[next]);
+    if (data[next] >= x)
+      return Linear::reverse(data, next, x, stats);
+    else
+      return Linear::forward(data, next + 1, x, stats);
+  }
+};
+
+#endif //DIRECT_H
@@ -4,12 +4,19 @@
 #include <assert.h>
 #include <cstdint>
 
+// A slope numerator / denominator as a 64 bit fraction and a shift, so that
+// multiplying by it is a 128 bit multiplication and a shift. Slopes < 1 keep
+// all 64 bits of precision, slopes >= 1, such as that of keys as dense as
+// their positions, trade a bit of it for each doubling.
 class FixedPoint {
   using u128 = __uint128_t;
 
   uint64_t numerator;
+  // the slope is numerator / 2^(64 - shift)
+  int shift;
 
-  constexpr FixedPoint(uint64_t numerator) : numerator(numerator) {}
+  constexpr FixedPoint(uint64_t numerator, int shift)
+      : numerator(numerator), shift(shift) {}
 
 public:
   class Gen {
@@ -17,18 +24,26 @@ public:
 
   public:
     constexpr Gen(uint64_t numerator) : numerator(numerator) {}
+    // A slope of 0 for a denominator of 0, all keys equal.
     constexpr FixedPoint operator/(uint64_t denominator) {
+      if (denominator == 0)
+        return FixedPoint(0, 0);
+      // the smallest shift with numerator < denominator * 2^shift
+      int shift = 0;
+      while (shift < 64 && (numerator >> shift) >= denominator)
+        shift++;
       u128 fixed_numerator =
-          (((u128)numerator << 64) - 1 + denominator) / denominator;
+          (((u128)numerator << (64 - shift)) - 1 + denominator) / denominator;
 
-      assert(numerator < denominator);
-      assert(fixed_numerator <= ~0UL);
-
-      return fixed_numerator;
+      // rounding up can reach 2^64
+      if (fixed_numerator > ~0UL)
+        fixed_numerator = ~0UL;
+      return FixedPoint(fixed_numerator, shift);
     }
   };
 
-  uint64_t operator*(u128 x) const { return (x * numerator) >> 64; }
+  // shift is the number of integer bits of the slope, 0 for slopes < 1.
+  uint64_t operator*(u128 x) const { return (x * numerator) >> (64 - shift); }
 };
 
 #endif
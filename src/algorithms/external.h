@@ -0,0 +1,121 @@
+#ifndef EXTERNAL_H
+#define EXTERNAL_H
+
+#include "../paged_file.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <vector>
+
+// Searches of keys that stay in a key file, through a storage of
+// paged_file.h. The algorithms are shared by the threads and take the
+// storage of the calling thread with each search, which counts the pages
+// touched. search returns the position of the first key >= x.
+
+// Binary Search, each probe can touch a page until the interval fits in one.
+template <class Storage>
+class ExternalBinary {
+  Index n;
+
+ public:
+  ExternalBinary(Storage &s) : n(s.size()) {}
+
+  Index search(Storage &s, const Key x) const {
+    Index left = 0, len = n;
+    while (len > 1) {
+      Index half = len / 2;
+      left = Storage::key(s, left + half) < x ? left + half : left;
+      len -= half;
+    }
+    return Storage::key(s, left) < x ? left + 1 : left;
+  }
+
+  size_t aux_bytes() const { return sizeof(*this); }
+};
+
+// Fence keys: the first key of every page is kept in memory, a search finds
+// its page there and touches only that page.
+template <class Storage>
+class ExternalFence {
+  std::vector<Key> fences;
+
+ public:
+  ExternalFence(Storage &s) : fences(s.pages()) {
+    for (Index p = 0; p < (Index)fences.size(); p++)
+      fences[p] = s.keys(p)[0];
+  }
+
+  Index search(Storage &s, const Key x) const {
+    Index p = std::upper_bound(fences.begin(), fences.end(), x) -
+              fences.begin() - 1;
+    p = std::max<Index>(p, 0);
+    const Key *keys = s.keys(p);
+    const Index begin = Storage::page_begin(p), end = s.page_end(p);
+    return begin + (std::lower_bound(keys, keys + (end - begin), x) - keys);
+  }
+
+  size_t aux_bytes() const {
+    return sizeof(*this) + fences.capacity() * sizeof(Key);
+  }
+};
+
+// Interpolation Search that reads a page per interpolation: it searches the
+// page in memory when x falls within it and otherwise narrows the interval
+// to one side of the page. After max_pages pages it falls back to Binary
+// Search of the rest, which bounds the pages touched to O(log n).
+template <class Storage, int max_pages = 4>
+class ExternalInterpolation {
+  Index n;
+  Key first, last;
+
+ public:
+  ExternalInterpolation(Storage &s)
+      : n(s.size()), first(Storage::key(s, 0)),
+        last(Storage::key(s, s.size() - 1)) {}
+
+  Index search(Storage &s, const Key x) const {
+    if (x <= first)
+      return 0;
+    if (x > last)
+      return n;
+    // The answer is in [left, right], the keys before left are < x and keys
+    // after right are >= x. Keys in the interval lie within [k_left, k_right].
+    Index left = 0, right = n - 1;
+    Key k_left = first, k_right = last;
+    for (int i = 0; i < max_pages && left < right; i++) {
+      Index next = left + (Index)(((double)x - (double)k_left) /
+                                  ((double)k_right - (double)k_left) *
+                                  (double)(right - left));
+      next = std::clamp(next, left, right);
+      const Index p = Storage::page_of(next);
+      const Index begin = Storage::page_begin(p);
+      const Key *keys = s.keys(p);
+      const Index a = std::max(begin, left), b = std::min(s.page_end(p) - 1, right);
+      if (x <= keys[a - begin]) {
+        if (a == left)
+          return a;
+        right = a;
+        k_right = keys[a - begin];
+      } else if (x > keys[b - begin]) {
+        if (b == right)
+          return right + 1;
+        left = b + 1;
+        k_left = keys[b - begin];
+      } else {
+        return a + (std::lower_bound(keys + (a - begin), keys + (b - begin), x) -
+                    (keys + (a - begin)));
+      }
+    }
+    Index len = right - left + 1;
+    while (len > 1) {
+      Index half = len / 2;
+      left = Storage::key(s, left + half) < x ? left + half : left;
+      len -= half;
+    }
+    return Storage::key(s, left) < x ? left + 1 : left;
+  }
+
+  size_t aux_bytes() const { return sizeof(*this); }
+};
+
+#endif //EXTERNAL_H
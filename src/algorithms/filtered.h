@@ -0,0 +1,114 @@
+#ifndef FILTERED_H
+#define FILTERED_H
+
+#include "../padded_vector.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Blocked Bloom filter: each key sets k bits of one block of 512 bits, a
+// cache line, so a lookup reads one line. It trades a slightly higher false
+// positive rate than a standard Bloom filter of the same size for a single
+// cache miss per lookup.
+class BlockedBloom {
+  struct alignas(64) Block {
+    uint64_t words[8];
+  };
+
+  std::vector<Block> blocks;
+  int k;
+
+  static uint64_t hash(const Key x) {
+    // fmix64 of MurmurHash3
+    uint64_t h = x;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // The block from the high bits of the hash, the bits from the low ones by
+  // double hashing.
+  const Block &block_of(const uint64_t h) const {
+    return blocks[(__uint128_t)h * blocks.size() >> 64];
+  }
+  Block &block_of(const uint64_t h) {
+    return blocks[(__uint128_t)h * blocks.size() >> 64];
+  }
+  static unsigned bit(const uint64_t h, const int i) {
+    return ((uint32_t)h + i * ((uint32_t)(h >> 16) | 1)) & 511;
+  }
+
+ public:
+  // For n keys with about bits_per_key bits each.
+  BlockedBloom(const size_t n, const double bits_per_key)
+      : blocks(std::max<size_t>(1, std::ceil(n * bits_per_key / 512))),
+        k(std::min(16, std::max(1, (int)std::lround(bits_per_key *
+                                                    std::log(2.0))))) {
+    std::fill(blocks.begin(), blocks.end(), Block{});
+  }
+
+  template <class Vector>
+  BlockedBloom(const Vector &keys, const double bits_per_key)
+      : BlockedBloom(keys.size(), bits_per_key) {
+    for (Key x : keys)
+      insert(x);
+  }
+
+  void insert(const Key x) {
+    const uint64_t h = hash(x);
+    Block &b = block_of(h);
+    for (int i = 0; i < k; i++)
+      b.words[bit(h, i) / 64] |= 1UL << (bit(h, i) % 64);
+  }
+
+  // False for most keys that were not inserted, true for all that were.
+  __attribute__((always_inline)) bool may_contain(const Key x) const {
+    const uint64_t h = hash(x);
+    const Block &b = block_of(h);
+    bool found = true;
+    for (int i = 0; i < k; i++)
+      found &= (b.words[bit(h, i) / 64] >> (bit(h, i) % 64)) & 1;
+    return found;
+  }
+
+  size_t bytes() const { return blocks.capacity() * sizeof(Block); }
+  int hashes() const { return k; }
+};
+
+// Any search algorithm behind a BlockedBloom of the keys: a key the filter
+// rejects is not searched and not_found is returned. The record at not_found
+// is in the padding before the records, it holds the smallest Key.
+template <class SearchAlgorithm, int record_bytes> class Filtered {
+  using Vector = PaddedVector<record_bytes>;
+
+  const BlockedBloom bloom;
+  SearchAlgorithm searchAlgorithm;
+
+ public:
+  static constexpr Index not_found = -1;
+
+  Filtered(const Vector &data, const double bits_per_key = 10)
+      : bloom(data, bits_per_key), searchAlgorithm(data) {}
+
+  __attribute__((always_inline)) Index search(const Key x) {
+    return bloom.may_contain(x) ? (Index)searchAlgorithm.search(x) : not_found;
+  }
+
+  const auto &records() const { return searchAlgorithm.records(); }
+  const BlockedBloom &filter() const { return bloom; }
+  SearchAlgorithm &unfiltered() { return searchAlgorithm; }
+
+  // Bytes held besides the records searched, the filter included.
+  size_t aux_bytes() const {
+    return sizeof(*this) + bloom.bytes() + searchAlgorithm.aux_bytes() -
+           sizeof(searchAlgorithm);
+  }
+};
+
+#endif //FILTERED_H
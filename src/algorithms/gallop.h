@@ -0,0 +1,78 @@
+#ifndef GALLOP_H
+#define GALLOP_H
+
+#include "../padded_vector.h"
+#include "../util.h"
+
+#include <utility>
+
+// Exponential (galloping) search outward from a hint position, followed by a
+// binary search of the last doubling step. Costs O(log d) probes where d is
+// the distance between the hint and the answer.
+template <class Vector> class Gallop {
+  // Returns the first position in [0, size] whose key is >= x (upper = false)
+  // or > x (upper = true).
+  template <bool upper>
+  static Index bound(const Vector &a, Index hint, const Key x) {
+    const Index n = a.size();
+    auto before = [&](Index i) { return upper ? a[i] <= x : a[i] < x; };
+    hint = std::min(std::max(hint, 0L), n - 1);
+
+    // find lo, hi such that the answer is in [lo, hi]
+    Index lo, hi;
+    if (before(hint)) {
+      lo = hint + 1;
+      for (Index step = 1;; step *= 2) {
+        Index probe = lo - 1 + step;
+        if (probe >= n) {
+          hi = n;
+          break;
+        }
+        if (!before(probe)) {
+          hi = probe;
+          break;
+        }
+        lo = probe + 1;
+      }
+    } else {
+      hi = hint;
+      for (Index step = 1;; step *= 2) {
+        Index probe = hi - step;
+        if (probe < 0) {
+          lo = 0;
+          break;
+        }
+        if (before(probe)) {
+          lo = probe + 1;
+          break;
+        }
+        hi = probe;
+      }
+    }
+
+    while (lo < hi) {
+      Index mid = lo + (hi - lo) / 2;
+      if (before(mid))
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+ public:
+  static Index lower_bound(const Vector &a, const Index hint, const Key x) {
+    return bound<false>(a, hint, x);
+  }
+  static Index upper_bound(const Vector &a, const Index hint, const Key x) {
+    return bound<true>(a, hint, x);
+  }
+  // Both ends of the run of keys equal to x, galloping outward from hint
+  // (usually a matching position).
+  static std::pair<Index, Index> equal_range(const Vector &a, const Index hint,
+                                             const Key x) {
+    return {lower_bound(a, hint, x), upper_bound(a, hint, x)};
+  }
+};
+
+#endif //GALLOP_H
@@ -0,0 +1,142 @@
+#ifndef INTERPOLATION_BINARY_H
+#define INTERPOLATION_BINARY_H
+
+#include "gallop.h"
+#include "linear_search.h"
+#include "../index_file.h"
+#include "../padded_vector.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <string>
+
+// Interpolation-Binary Search - IBS
+// Interpolation Search that bisects the range after every interpolation that
+// does not shrink it to at most 1/shrink of its width. Each interpolation that
+// fails is followed by a bisection, so the range at least halves every two
+// probes and a search takes at most 2 log2(n) probes on any data, where
+// Interpolation Search can take O(n) on skewed keys (fal, cfal). On keys
+// close to uniform the interpolations succeed and it probes like IS. The
+// first interpolation reuses the slope of the whole array as SIP does, and
+// the base case is a linear search of at most 2 * guard_off records.
+template <int record_bytes, int shrink = 2, int guard_off = 8,
+          class Stats = NoStats>
+class InterpolationBinary {
+  using Vector = PaddedVector<record_bytes>;
+  using Linear = LinearUnroll<Vector>;
+
+  const Vector &data;
+  [[no_unique_address]] Stats lookup_stats;
+  const double f_aL;
+  const double f_width_range;
+
+  Index clamp(const Index ix, const Index left, const Index right) const {
+    return std::min(std::max(ix, left), right);
+  }
+
+  // Interpolation between the records at left and right, x may lie outside
+  // of them when it is absent.
+  Index interpolate(const Key x, const Index left, const Index right) {
+    lookup_stats.touch(&data[left]);
+    lookup_stats.touch(&data[right]);
+    if (data[right] <= data[left])
+      return left + (right - left) / 2;
+    double f = ((double)x - (double)data[left]) /
+               ((double)data[right] - (double)data[left]);
+    f = std::min(std::max(f, 0.0), 1.0);
+    return left + (Index)(f * (double)(right - left));
+  }
+
+  // The constants computed at construction, saved in an IndexFile.
+  struct Saved {
+    double f_aL, f_width_range;
+  };
+
+  InterpolationBinary(const Vector &data, const Saved &saved)
+      : data(data), f_aL(saved.f_aL), f_width_range(saved.f_width_range) {}
+
+ public:
+  InterpolationBinary(const Vector &data)
+      : data(data), f_aL(data[0]),
+        f_width_range(data.back() == data[0]
+                          ? 0.0
+                          : (double)((uint64_t)data.size() - 1) /
+                                ((double)data.back() - (double)data[0])) {}
+
+  static constexpr char index_name[] = "ibs";
+
+  // Loads an index saved by save(), searching the records of the file.
+  InterpolationBinary(const IndexFile<record_bytes> &file)
+      : InterpolationBinary(file.records(),
+                            file.template section<Saved>(index_name)) {}
+
+  void save(const std::string &path) const {
+    typename IndexFile<record_bytes>::Writer out(path, index_name, data);
+    out.section(index_name, Saved{f_aL, f_width_range});
+  }
+
+  // Returns a position of x, or of the first key > x if x is absent.
+  __attribute__((always_inline)) Index search(const Key x) {
+    assert(data.size() >= 1);
+    Index left = 0, right = data.size() - 1;
+    Index next = clamp((Index)(((double)x - f_aL) * f_width_range), left,
+                       right);
+    while (right - left > 2 * guard_off) {
+      const Index width = right - left;
+      lookup_stats.probe(Probe::Interpolation, &data[next]);
+      if (data[next] < x)
+        left = next + 1;
+      else if (data[next] > x)
+        right = next - 1;
+      else
+        return next;
+
+      if (right - left > width / shrink) {
+        // the interpolation failed, bisect
+        next = left + (right - left) / 2;
+        lookup_stats.probe(Probe::Bisection, &data[next]);
+        if (data[next] < x)
+          left = next + 1;
+        else if (data[next] > x)
+          right = next - 1;
+        else
+          return next;
+      }
+      if (left > right)
+        return left;
+      next = interpolate(x, left, right);
+    }
+    // linear search base case, the records after right are >= x
+    lookup_stats.guard();
+    return Linear::forward(data, left, x, lookup_stats);
+  }
+
+  // Finger search, gallops from hint, such as the result of a previous
+  // search.
+  __attribute__((always_inline)) Index search_from(const Index hint,
+                                                   const Key x) {
+    return Gallop<Vector>::lower_bound(data, hint, x);
+  }
+
+  const Vector &records() const { return data; }
+
+  // The same search instrumented with the policy S, see lookup_stats.h.
+  template <class S>
+  using with_stats = InterpolationBinary<record_bytes, shrink, guard_off, S>;
+  Stats &stats() { return lookup_stats; }
+
+  // Bytes held besides the records searched.
+  size_t aux_bytes() const { return sizeof(*this); }
+
+  // The positions of the first and one past the last record with key x.
+  std::pair<Index, Index> equal_range(const Key x) {
+    return Gallop<Vector>::equal_range(data, search(x), x);
+  }
+
+  Index count(const Key x) {
+    auto range = equal_range(x);
+    return range.second - range.first;
+  }
+};
+
+#endif //INTERPOLATION_BINARY_H
@@ -1,7 +1,10 @@
 #ifndef INTERPOLATION_SEARCH_H
 #define INTERPOLATION_SEARCH_H
 
+#include "direct.h"
 #include "div.h"
+#include "gallop.h"
+#include "../index_file.h"
 
 #include <algorithm>
 #include <array>
@@ -14,12 +17,14 @@
 
 
 // Interpolation Seach - IS
-template <int record_bytes>
+template <int record_bytes, class Stats = NoStats>
 class InterpolationSearch {
   using Vector = PaddedVector<record_bytes>;
   using Linear = LinearUnroll<Vector>;
 
   const Vector &data;
+  const DirectAddress<Vector> direct;
+  [[no_unique_address]] Stats lookup_stats;
 
   /////// Interpolator /////
   const FixedPoint slope;
@@ -30,34 +35,68 @@ class InterpolationSearch {
     return (Index)(((double)x - f_aL) * f_width_range);
   }
 
+  // Clamped to [left, right], x is outside of the records at left and right
+  // when it is absent.
   Index interpolate(const Key x, const Index left, const Index right) {
-    return left +
-      ((double)x - (double)(data[left])) / (double)(data[right] - data[left]) *
+    lookup_stats.touch(&data[left]);
+    lookup_stats.touch(&data[right]);
+    const Index next = left +
+      ((double)x - (double)(data[left])) /
+          ((double)data[right] - (double)data[left]) *
           (double)(right - left);
+    return std::min(std::max(next, left), right);
   }
   /////////////////////////
 
+  // The constants computed at construction, saved in an IndexFile.
+  struct Saved {
+    FixedPoint slope;
+    double f_aL, f_width_range;
+    DirectAddress<Vector> direct;
+  };
+
+  InterpolationSearch(const Vector &data, const Saved &saved)
+      : data(data), direct(saved.direct), slope(saved.slope),
+        f_aL(saved.f_aL), f_width_range(saved.f_width_range) {}
+
  public:
   InterpolationSearch(const Vector &data)
-    : data(data),
-      slope(FixedPoint::Gen(data.size() - 1) / (data.back() - data[0])),
+    : data(data), direct(data),
+      slope(FixedPoint::Gen(data.size() - 1) /
+            ((uint64_t)data.back() - (uint64_t)data[0])),
       f_aL (data[0]),
       f_width_range ((double)((uint64_t)data.size() - 1) /
-          (double)(data.back() - data[0]))
+          ((double)data.back() - (double)data[0]))
   {}
 
-  __attribute__((always_inline)) Key search(const Key x) {
+  static constexpr char index_name[] = "is";
+
+  // Loads an index saved by save(), searching the records of the file.
+  InterpolationSearch(const IndexFile<record_bytes> &file)
+      : InterpolationSearch(file.records(),
+                            file.template section<Saved>(index_name)) {}
+
+  void save(const std::string &path) const {
+    typename IndexFile<record_bytes>::Writer out(path, index_name, data);
+    out.section(index_name, Saved{slope, f_aL, f_width_range, direct});
+  }
+
+  __attribute__((always_inline)) Index search(const Key x) {
     assert(data.size() >= 1);
+    if (direct.applies())
+      return direct.search(data, x, lookup_stats);
     Index left = 0, right = data.size() - 1, next = interpolate(x);
     while(true) {
+      lookup_stats.probe(Probe::Interpolation, &data[next]);
       if (data[next] < x)
         left = next + 1;
       else if (data[next] > x)
         right = next - 1;
       else
-        return data[next];
-      if (left == right)
-        return data[left];
+        return next;
+      // left passes right when x is absent
+      if (left >= right)
+        return left;
 
       assert(left < right);
       assert(left >= 0);
@@ -70,11 +109,37 @@ class InterpolationSearch {
     }
     // linear search base case
     if (data[next] >= x) {
-      return data[Linear::reverse(data, next, x)];
+      return Linear::reverse(data, next, x, lookup_stats);
     } else {
-      return data[Linear::forward(data, next + 1, x)];
+      return Linear::forward(data, next + 1, x, lookup_stats);
     }
   }
+
+  // Finger search, gallops from hint, such as the result of a previous
+  // search.
+  __attribute__((always_inline)) Index search_from(const Index hint,
+                                                   const Key x) {
+    return Gallop<Vector>::lower_bound(data, hint, x);
+  }
+
+  const Vector &records() const { return data; }
+
+  // The same search instrumented with the policy S, see lookup_stats.h.
+  template <class S> using with_stats = InterpolationSearch<record_bytes, S>;
+  Stats &stats() { return lookup_stats; }
+
+  // Bytes held besides the records searched.
+  size_t aux_bytes() const { return sizeof(*this); }
+
+  // The positions of the first and one past the last record with key x.
+  std::pair<Index, Index> equal_range(const Key x) {
+    return Gallop<Vector>::equal_range(data, search(x), x);
+  }
+
+  Index count(const Key x) {
+    auto range = equal_range(x);
+    return range.second - range.first;
+  }
 };
 
 #endif //INTERPOLATION_SEARCH_H
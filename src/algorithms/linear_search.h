@@ -1,15 +1,18 @@
 #ifndef LIN_H
 #define LIN_H
 
+#include "lookup_stats.h"
 #include "../padded_vector.h"
 #include "../util.h"
 #include <x86intrin.h>
 
 template <class Vector, int n = 8> class LinearUnroll {
-  template <bool reverse = false>
-  static int64_t linearSearchUnroll(const Vector &a, int64_t m, Key k) {
+  template <bool reverse, class Stats>
+  static int64_t linearSearchUnroll(const Vector &a, int64_t m, Key k,
+                                    Stats &stats) {
     for (;; m = (reverse ? m - n : m + n)) {
       for (int i = 0; i < n; i++) {
+        stats.linear(&a[reverse ? m - i : m + i]);
         if (reverse ? (a[m - i] <= k) : (a[m + i] >= k)) {
           return reverse ? (m - i) : (m + i);
         }
@@ -18,34 +21,15 @@ template <class Vector, int n = 8> class LinearUnroll {
   }
 
 public:
-  static int64_t forward(const Vector &a, const int64_t guessIx, const Key x) {
-    return linearSearchUnroll<false>(a, guessIx, x);
+  template <class Stats = NoStats>
+  static int64_t forward(const Vector &a, const int64_t guessIx, const Key x,
+                         Stats &&stats = Stats()) {
+    return linearSearchUnroll<false>(a, guessIx, x, stats);
   }
-  static int64_t reverse(const Vector &a, const int64_t guessIx, const Key x) {
-    return linearSearchUnroll<true>(a, guessIx, x);
-  }
-};
-
-template <class Vector, int n = 8> class LinearUnrollMetadata {
-  template <bool reverse = false>
-  static int64_t linearSearchUnroll(const Vector &a, int64_t m, Key k) {
-    int counter = 0;
-    for (;; m = (reverse ? m - n : m + n)) {
-      for (int i = 0; i < n; i++) {
-        counter++;
-        if (reverse ? (a[m - i] <= k) : (a[m + i] >= k)) {
-         return counter;
-        }
-      }
-    }
-  }
-
- public:
-  static int64_t forward(const Vector &a, const int64_t guessIx, const Key x) {
-    return linearSearchUnroll<false>(a, guessIx, x);
-  }
-  static int64_t reverse(const Vector &a, const int64_t guessIx, const Key x) {
-    return linearSearchUnroll<true>(a, guessIx, x);
+  template <class Stats = NoStats>
+  static int64_t reverse(const Vector &a, const int64_t guessIx, const Key x,
+                         Stats &&stats = Stats()) {
+    return linearSearchUnroll<true>(a, guessIx, x, stats);
   }
 };
 
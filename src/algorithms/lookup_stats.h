@@ -0,0 +1,143 @@
+#ifndef LOOKUP_STATS_H
+#define LOOKUP_STATS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Instrumentation policies of the search algorithms, the Stats template
+// parameter of each. An algorithm reports the records its search() reads:
+// the probes of its interpolation or bisection phase, a guard that hands over
+// to the linear search, the records that search compares, and the records it
+// reads besides, such as the ends of the range it interpolates between.
+// NoStats, the default, ignores them and compiles to nothing. LookupStats
+// counts them for one lookup at a time (see searchAndMetadata), an
+// instrumented algorithm is searched from one thread.
+enum class Probe { Interpolation, Bisection };
+
+struct NoStats {
+  static constexpr bool enabled = false;
+  void probe(Probe, const void *) {}
+  void guard() {}
+  void linear(const void *) {}
+  void touch(const void *) {}
+};
+
+class LookupStats {
+  // The distinct cache lines read: a hash set of the lines of the lookup,
+  // cleared by a new generation. Past max_lines lines every line other than
+  // the last one read is counted, without checking that it is distinct.
+  static constexpr int slots = 1024, max_lines = slots / 2;
+  struct Slot {
+    uintptr_t line;
+    uint32_t generation;
+  };
+  std::vector<Slot> set;
+  uint32_t generation;
+  uintptr_t last_line;
+  int n_lines;
+
+  void read(const void *record) {
+    const uintptr_t line = (uintptr_t)record / 64;
+    if (line == last_line)
+      return;
+    last_line = line;
+    if (n_lines < max_lines) {
+      for (uint32_t h = (line * 0x9e3779b97f4a7c15ULL) >> 54;;
+           h = (h + 1) % slots) {
+        if (set[h].generation != generation) {
+          set[h] = {line, generation};
+          break;
+        }
+        if (set[h].line == line)
+          return;
+      }
+    }
+    n_lines++;
+  }
+
+ public:
+  static constexpr bool enabled = true;
+  int interpolations, bisections, guards, linear_steps;
+
+  LookupStats() : set(slots, Slot{0, 0}), generation(0) { reset(); }
+
+  // Before each lookup.
+  void reset() {
+    generation++;
+    last_line = ~(uintptr_t)0;
+    n_lines = interpolations = bisections = guards = linear_steps = 0;
+  }
+
+  void probe(const Probe kind, const void *record) {
+    (kind == Probe::Interpolation ? interpolations : bisections)++;
+    read(record);
+  }
+  void guard() { guards++; }
+  void linear(const void *record) {
+    linear_steps++;
+    read(record);
+  }
+  void touch(const void *record) { read(record); }
+
+  // Distinct cache lines read by the lookup.
+  int lines() const { return n_lines; }
+};
+
+// Histogram of a count of LookupStats over the lookups of a run, with the
+// mean latency of the lookups of each bucket. Values below 16 have a bucket
+// each, above that a power of two.
+class WorkHistogram {
+  static constexpr int exact = 16;
+
+  struct Bucket {
+    uint64_t lookups = 0;
+    double ns = 0;
+  };
+  std::vector<Bucket> buckets;
+  uint64_t n = 0;
+  double total = 0;
+
+  static int bucket(const uint64_t value) {
+    if (value < exact)
+      return value;
+    return exact + (63 - __builtin_clzl(value)) - __builtin_ctz(exact);
+  }
+
+  static std::string label(const int b) {
+    if (b < exact)
+      return std::to_string(b);
+    const uint64_t lowest = (uint64_t)exact << (b - exact);
+    return std::to_string(lowest) + "-" + std::to_string(2 * lowest - 1);
+  }
+
+ public:
+  WorkHistogram() : buckets(exact + 64) {}
+
+  void record(const uint64_t value, const double ns) {
+    buckets[bucket(value)].lookups++;
+    buckets[bucket(value)].ns += ns;
+    n++;
+    total += value;
+  }
+
+  double mean() const { return n == 0 ? 0 : total / n; }
+
+  // One line per non-empty bucket: the values, the fraction of the lookups
+  // and their mean latency.
+  void print(std::ostream &out, const std::string &name) const {
+    out << name << ": mean " << mean() << '\n';
+    for (int b = 0; b < (int)buckets.size(); b++)
+      if (buckets[b].lookups > 0)
+        out << std::setw(14) << label(b) << std::setw(10) << std::fixed
+            << std::setprecision(4) << buckets[b].lookups / (double)n
+            << std::setw(10) << std::setprecision(1)
+            << buckets[b].ns / buckets[b].lookups << " ns\n"
+            << std::defaultfloat << std::setprecision(6);
+  }
+};
+
+#endif //LOOKUP_STATS_H
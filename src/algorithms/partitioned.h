@@ -0,0 +1,162 @@
+#ifndef PARTITIONED_H
+#define PARTITIONED_H
+
+#include "div.h"
+#include "linear_search.h"
+#include "../padded_vector.h"
+#include "../util.h"
+
+#include <vector>
+
+// An index over many small independent sorted arrays (partitions). The
+// records of all partitions are stored back to back in one PaddedVector and
+// the search metadata of every partition is one entry of a contiguous table,
+// so the per-partition setup is only the construction of its Meta.
+//
+// Meta holds the per-partition search state, it is constructed from the
+// partition's bounds and searches the range [begin, begin + size).
+
+template <int record_bytes, class Meta>
+class PartitionedIndex {
+  using Vector = PaddedVector<record_bytes>;
+
+  struct Entry {
+    Index begin;
+    uint32_t size;
+    Meta meta;
+  };
+
+  const Vector &data;
+  std::vector<Entry> table;
+
+ public:
+  struct Query {
+    Index partition;
+    Key key;
+  };
+
+  // bounds holds the first record of each partition followed by the end of
+  // the last partition.
+  PartitionedIndex(const Vector &data, const std::vector<Index> &bounds)
+      : data(data) {
+    assert(bounds.size() >= 2);
+    table.reserve(bounds.size() - 1);
+    for (auto it = bounds.begin(); it + 1 != bounds.end(); it++) {
+      assert(it[1] > it[0]);
+      table.push_back(
+          {it[0], (uint32_t)(it[1] - it[0]), Meta(data, it[0], it[1] - it[0])});
+    }
+  }
+
+  // Returns the position of the record in records().
+  __attribute__((always_inline)) Index search(const Index partition,
+                                              const Key x) {
+    const Entry &e = table[partition];
+    return e.meta.search(data, e.begin, e.size, x);
+  }
+
+  const Vector &records() const { return data; }
+
+  // Bytes held besides the records searched.
+  size_t aux_bytes() const {
+    return sizeof(*this) + table.capacity() * sizeof(Entry);
+  }
+
+  size_t partitions() const { return table.size(); }
+  static constexpr size_t metadata_bytes() { return sizeof(Entry); }
+};
+
+// Branch-free binary search, needs no per-partition state.
+struct PartitionBinary {
+  template <class Vector>
+  PartitionBinary(const Vector &, Index, Index) {}
+
+  template <class Vector>
+  __attribute__((always_inline)) Index search(const Vector &data, Index left,
+                                              Index n, const Key x) const {
+    while (n > 1) {
+      Index half = n / 2;
+      left = data[left + half] <= x ? left + half : left;
+      n -= half;
+    }
+    return left;
+  }
+};
+
+// One double precision interpolation followed by a linear search, as isseq.
+struct PartitionIsSeq {
+  Key first;
+  double width_range;
+
+  template <class Vector>
+  PartitionIsSeq(const Vector &data, Index begin, Index n)
+      : first(data[begin]),
+        width_range((double)(n - 1) /
+                    ((double)data[begin + n - 1] - (double)data[begin])) {}
+
+  template <class Vector>
+  __attribute__((always_inline)) Index search(const Vector &data, Index begin,
+                                              Index n, const Key x) const {
+    using Linear = LinearUnroll<Vector>;
+    // bound x by the partition, the linear search needs a stopping record
+    if (x <= first)
+      return begin;
+    if (x >= data[begin + n - 1])
+      return begin + n - 1;
+    Index next = begin + (Index)(((double)x - (double)first) * width_range);
+    if (data[next] >= x)
+      return Linear::reverse(data, next, x);
+    else
+      return Linear::forward(data, next + 1, x);
+  }
+};
+
+// SIP restricted to one partition. Construction pays for the fixed point
+// slope, a 128 bit division.
+template <int guard_off = 8>
+struct PartitionSipGuard {
+  FixedPoint slope;
+  Key first;
+
+  template <class Vector>
+  PartitionSipGuard(const Vector &data, Index begin, Index n)
+      : slope(FixedPoint::Gen(n - 1) /
+              ((uint64_t)data[begin + n - 1] - (uint64_t)data[begin])),
+        first(data[begin]) {}
+
+  template <class Vector>
+  __attribute__((always_inline)) Index search(const Vector &data, Index begin,
+                                              Index n, const Key x) const {
+    using Linear = LinearUnroll<Vector>;
+    if (x <= first)
+      return begin;
+    if (x >= data[begin + n - 1])
+      return begin + n - 1;
+    Index left = begin, right = begin + n - 1,
+          next = begin + slope * ((uint64_t)x - (uint64_t)first);
+    while (true) {
+      if (data[next] < x)
+        left = next + 1;
+      else if (data[next] > x)
+        right = next - 1;
+      else
+        return next;
+      if (left == right)
+        return left;
+
+      assert(left < right);
+      next = x < data[next]
+                 ? next - slope * ((uint64_t)data[next] - (uint64_t)x)
+                 : next + slope * ((uint64_t)x - (uint64_t)data[next]);
+
+      if (next + guard_off >= right)
+        return Linear::reverse(data, right, x);
+      else if (next - guard_off <= left)
+        return Linear::forward(data, left, x);
+    }
+  }
+};
+
+using PartitionSip = PartitionSipGuard<>;
+
+#endif //PARTITIONED_H
@@ -0,0 +1,138 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include "../padded_vector.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <memory>
+#include <omp.h>
+#include <vector>
+
+// Range partitioned execution: the records are split into one contiguous
+// shard per thread, each with its own copy of the records and its own
+// SearchAlgorithm, built by the owning thread so that first touch places it
+// on the thread's NUMA node. A batch of queries is radix partitioned by shard
+// and each thread searches only the queries of its shard, so a thread's
+// working set is its shard instead of the whole array.
+
+template <class SearchAlgorithm, int record_bytes>
+class Sharded {
+  using Vector = PaddedVector<record_bytes>;
+
+  struct Shard {
+    Vector records;
+    SearchAlgorithm searchAlgorithm;
+
+    static Vector slice(const Vector &all, const Index begin, const Index end) {
+      Vector v(end - begin);
+      for (Index i = begin; i < end; i++)
+        v.record(i - begin) = all.record(i);
+      return v;
+    }
+
+    Shard(const Vector &all, const Index begin, const Index end)
+        : records(slice(all, begin, end)), searchAlgorithm(records) {}
+  };
+
+  const int n_shards;
+  std::vector<std::unique_ptr<Shard>> shards;
+  // first key of shards 1 to n_shards - 1
+  std::vector<Key> bounds;
+
+  // Routing of a batch: counts[t * n_shards + s] is the number of queries of
+  // thread t's part for shard s, then where they go in routed.
+  std::vector<long> counts;
+  std::vector<Key> routed;
+  std::vector<long> shard_begin;
+
+ public:
+  // Built by a team of n_shards threads.
+  Sharded(const Vector &all, const int n_shards)
+      : n_shards(n_shards), shards(n_shards), bounds(n_shards - 1),
+        counts(n_shards * n_shards), shard_begin(n_shards + 1) {
+    assert((Index)all.size() >= n_shards);
+#pragma omp parallel num_threads(n_shards)
+    {
+      const int s = omp_get_thread_num();
+      const Index begin = all.size() * s / n_shards,
+                  end = all.size() * (s + 1) / n_shards;
+      shards[s] = std::make_unique<Shard>(all, begin, end);
+      if (s > 0)
+        bounds[s - 1] = all[begin];
+    }
+  }
+
+  // The shard holding x: the last one whose first key is <= x.
+  int shard_of(const Key x) const {
+    return std::upper_bound(bounds.begin(), bounds.end(), x) - bounds.begin();
+  }
+
+  // Called by every thread of a team of n_shards threads, searches
+  // keys[(first + j) % n_keys] for j in [0, len). Each thread routes a part of
+  // the batch, then searches the queries of its shard. Returns the sum of the
+  // keys found by the calling thread.
+  unsigned long search_batch(const Key *keys, const long n_keys,
+                             const long first, const long len) {
+    assert(len <= n_keys);
+    const int t = omp_get_thread_num();
+    assert(omp_get_num_threads() == n_shards);
+#pragma omp single
+    routed.resize(len);
+    const long begin = len * t / n_shards, end = len * (t + 1) / n_shards;
+    auto key = [&](long j) {
+      long i = first + j;
+      return keys[i < n_keys ? i : i - n_keys];
+    };
+
+    // histogram of the thread's part
+    long *count = &counts[t * n_shards];
+    std::fill(count, count + n_shards, 0);
+    for (long j = begin; j < end; j++)
+      count[shard_of(key(j))]++;
+#pragma omp barrier
+#pragma omp single
+    {
+      // exclusive prefix sum, by shard then thread
+      long offset = 0;
+      for (int s = 0; s < n_shards; s++) {
+        shard_begin[s] = offset;
+        for (int u = 0; u < n_shards; u++) {
+          long c = counts[u * n_shards + s];
+          counts[u * n_shards + s] = offset;
+          offset += c;
+        }
+      }
+      shard_begin[n_shards] = offset;
+    }
+    for (long j = begin; j < end; j++) {
+      Key x = key(j);
+      routed[count[shard_of(x)]++] = x;
+    }
+#pragma omp barrier
+
+    SearchAlgorithm &searchAlgorithm = shards[t]->searchAlgorithm;
+    const auto &records = searchAlgorithm.records();
+    unsigned long sum = 0;
+    for (long j = shard_begin[t]; j < shard_begin[t + 1]; j++) {
+      auto val = records[searchAlgorithm.search(routed[j])];
+      sum += val;
+      assert(val == routed[j]);
+    }
+    return sum;
+  }
+
+  // Bytes held besides the records, the shards' copies of them included.
+  size_t aux_bytes() const {
+    size_t bytes = sizeof(*this) + bounds.capacity() * sizeof(Key) +
+                   counts.capacity() * sizeof(long) +
+                   routed.capacity() * sizeof(Key) +
+                   shard_begin.capacity() * sizeof(long);
+    for (auto &s : shards)
+      bytes += sizeof(Shard) + s->records.bytes() +
+               s->searchAlgorithm.aux_bytes() - sizeof(s->searchAlgorithm);
+    return bytes;
+  }
+};
+
+#endif //SHARDED_H
@@ -1,14 +1,19 @@
 #ifndef SIP_H
 #define SIP_H
 
+#include "direct.h"
+#include "../index_file.h"
 
 // Slope-reuse Interpolation Search - SIP
-template <int record_bytes, bool multiple_iterations = true, int guard_off = 8>
+template <int record_bytes, bool multiple_iterations = true, int guard_off = 8,
+          class Stats = NoStats>
 class sip {
   using Vector = PaddedVector<record_bytes>;
   using Linear = LinearUnroll<Vector>;
 
   const Vector &data;
+  const DirectAddress<Vector, guard_off> direct;
+  [[no_unique_address]] Stats lookup_stats;
 
   /////// Interpolator /////////////////////////
   const FixedPoint slope;
@@ -16,108 +21,160 @@ class sip {
   const double f_width_range;
 
   Index interpolate(const Key x, const Index mid, bool approx = true) {
-    return approx ? (x < data[mid] ? mid - slope * (uint64_t)(data[mid] - x)
-                                   : mid + slope * (uint64_t)(x - data[mid]))
+    lookup_stats.touch(&data[mid]);
+    return approx ? (x < data[mid]
+                         ? mid - slope * ((uint64_t)data[mid] - (uint64_t)x)
+                         : mid + slope * ((uint64_t)x - (uint64_t)data[mid]))
                   : mid + (Index)(((double)x - (double)data[mid])
                     * f_width_range);
   }
 
   Index interpolate(const Key x, bool approx = true) {
-    return approx ? slope * (uint64_t)(x - data[0])
+    if (approx)
+      lookup_stats.touch(&data[0]);
+    return approx ? slope * ((uint64_t)x - (uint64_t)data[0])
                   : (Index)(((double)x - f_aL) * f_width_range);
   }
 
   //////////////////////////////////////////////
+
+  // The constants computed at construction, saved in an IndexFile.
+  struct Saved {
+    FixedPoint slope;
+    double f_aL, f_width_range;
+    DirectAddress<Vector, guard_off> direct;
+  };
+
+  sip(const Vector &data, const Saved &saved)
+      : data(data), direct(saved.direct), slope(saved.slope),
+        f_aL(saved.f_aL), f_width_range(saved.f_width_range) {}
+
+  Index clamp(const Index ix) const {
+    return std::min(std::max(ix, 0L), (Index)data.size() - 1);
+  }
+
+  // The search for x from the interpolation next, shared by search() and
+  // search_coro(). PROBE(p) comes before each interpolation probe of the
+  // record at p and RETURN returns the result.
+#define SIP_SEARCH(PROBE, RETURN)                                              \
+  assert(data.size() >= 1);                                                    \
+  /* set bounds */                                                             \
+  Index left = 0, right = data.size() - 1;                                     \
+                                                                               \
+  for (int i = 0; multiple_iterations; i++) {                                  \
+    /* update bounds and check for match */                                    \
+    PROBE(&data[next]);                                                        \
+    if (data[next] < x)                                                        \
+      left = next + 1;                                                         \
+    else if (data[next] > x)                                                   \
+      right = next - 1;                                                        \
+    else                                                                       \
+      RETURN next;                                                             \
+    if (left == right)                                                         \
+      RETURN left;                                                             \
+                                                                               \
+    /* next interpolation */                                                   \
+    assert(left < right);                                                      \
+    assert(left >= 0);                                                         \
+    assert(right < data.size());                                               \
+    next = interpolate(x, next);                                               \
+                                                                               \
+    /* apply guards */                                                         \
+    if (next + guard_off >= right) {                                           \
+      lookup_stats.guard();                                                    \
+      RETURN Linear::reverse(data, right, x, lookup_stats);                    \
+    } else if (next - guard_off <= left) {                                     \
+      lookup_stats.guard();                                                    \
+      RETURN Linear::forward(data, left, x, lookup_stats);                     \
+    }                                                                          \
+                                                                               \
+    assert(next >= left);                                                      \
+    assert(next <= right);                                                     \
+  }                                                                            \
+  /* linear search base case */                                                \
+  PROBE(&data[next]);                                                          \
+  if (data[next] >= x) {                                                       \
+    RETURN Linear::reverse(data, next, x, lookup_stats);                       \
+  } else {                                                                     \
+    RETURN Linear::forward(data, next + 1, x, lookup_stats);                   \
+  }
+#define SIP_PROBE(p) lookup_stats.probe(Probe::Interpolation, p)
+
+  // Searches for x starting with the interpolation next.
+  __attribute__((always_inline)) Index search(const Key x, Index next) {
+    SIP_SEARCH(SIP_PROBE, return)
+  }
+
  public:
   sip(const Vector &data)
-      : data(data),
-        slope(FixedPoint::Gen(data.size() - 1) / (data.back() - data[0])),
+      : data(data), direct(data),
+        slope(FixedPoint::Gen(data.size() - 1) /
+              ((uint64_t)data.back() - (uint64_t)data[0])),
         f_aL(data[0]),
         f_width_range((double)((uint64_t)data.size() - 1) /
-            (double)(data.back() - data[0]))
+            ((double)data.back() - (double)data[0]))
   {}
 
-  __attribute__((always_inline)) Key search(const Key x) {
-    assert(data.size() >= 1);
-    // set bounds and do first interpolation
-    Index left = 0, right = data.size() - 1, next = interpolate(x);
-
-    for (int i = 0; multiple_iterations; i++) {
-      // update bounds and check for match
-      if (data[next] < x)
-        left = next + 1;
-      else if (data[next] > x)
-        right = next - 1;
-      else
-        return data[next];
-      if (left == right)
-        return data[left];
-
-      // next interpolation
-      assert(left < right);
-      assert(left >= 0);
-      assert(right < data.size());
-      next = interpolate(x, next);
-
-      // apply guards
-      if (next + guard_off >= right)
-        return data[Linear::reverse(data, right, x)];
-      else if (next - guard_off <= left)
-        return data[Linear::forward(data, left, x)];
-
-      assert(next >= left);
-      assert(next <= right);
-    }
-    // linear search base case
-    if (data[next] >= x) {
-      return data[Linear::reverse(data, next, x)];
-    } else {
-      return data[Linear::forward(data, next + 1, x)];
-    }
-
-    return 0;
+  static constexpr char index_name[] = "sip";
+
+  // Loads an index saved by save(), searching the records of the file.
+  sip(const IndexFile<record_bytes> &file)
+      : sip(file.records(), file.template section<Saved>(index_name)) {}
+
+  void save(const std::string &path) const {
+    typename IndexFile<record_bytes>::Writer out(path, index_name, data);
+    out.section(index_name, Saved{slope, f_aL, f_width_range, direct});
+  }
+
+  __attribute__((always_inline)) Index search(const Key x) {
+    if (direct.applies())
+      return direct.search(data, x, lookup_stats);
+    // do first interpolation
+    return search(x, interpolate(x));
+  }
+
+  // Finger search, the first interpolation starts from the record at hint,
+  // such as the result of a previous search, instead of the first record.
+  __attribute__((always_inline)) Index search_from(const Index hint,
+                                                   const Key x) {
+    if (direct.applies())
+      return direct.search(data, x, lookup_stats);
+    return search(x, clamp(interpolate(x, clamp(hint))));
+  }
+
+#ifdef CORO_SEARCH
+  // search() as a coroutine, yields before each interpolation probe.
+#define SIP_PROBE_CORO(p) (SIP_PROBE(p), co_await Prefetch{p})
+  SearchTask search_coro(const Key x) {
+    if (direct.applies())
+      co_return direct.search(data, x, lookup_stats);
+    Index next = interpolate(x);
+    SIP_SEARCH(SIP_PROBE_CORO, co_return)
+  }
+#endif
+
+  const Vector &records() const { return data; }
+
+  // The same search instrumented with the policy S, see lookup_stats.h.
+  template <class S>
+  using with_stats = sip<record_bytes, multiple_iterations, guard_off, S>;
+  Stats &stats() { return lookup_stats; }
+
+  // Bytes held besides the records searched.
+  size_t aux_bytes() const { return sizeof(*this); }
+
+  // The positions of the first and one past the last record with key x.
+  std::pair<Index, Index> equal_range(const Key x) {
+    return Gallop<Vector>::equal_range(data, search(x), x);
   }
 
-  __attribute__((always_inline)) std::pair<int, int> search_metadata(const Key x) {
-    assert(data.size() >= 1);
-    // set bounds and do first interpolation
-    Index left = 0, right = data.size() - 1, next = interpolate(x);
-    int i = 1;
-    for (; multiple_iterations; ) {
-      // update bounds and check for match
-      if (data[next] < x)
-        left = next + 1;
-      else if (data[next] > x)
-        right = next - 1;
-      else
-        return {i, 0};
-      if (left == right)
-        return {i, 0};
-
-      // next interpolation
-      assert(left < right);
-      assert(left >= 0);
-      assert(right < data.size());
-      next = interpolate(x, next);
-      ++i;
-
-      // apply guards
-      if (next + guard_off >= right)
-        return {i, LinearUnrollMetadata<Vector>::reverse(data, right, x)};
-      else if (next - guard_off <= left)
-        return {i, LinearUnrollMetadata<Vector>::forward(data, left, x)};
-      assert(next >= left);
-      assert(next <= right);
-    }
-    // linear search base case
-    if (data[next] >= x) {
-      return {i, LinearUnrollMetadata<Vector>::reverse(data, next, x)};
-    } else {
-      return {i, LinearUnrollMetadata<Vector>::forward(data, next + 1, x)};
-    }
-
-    return {0,0};
+  Index count(const Key x) {
+    auto range = equal_range(x);
+    return range.second - range.first;
   }
 };
+#undef SIP_SEARCH
+#undef SIP_PROBE
+#undef SIP_PROBE_CORO
 
 #endif //SIP_H
@@ -0,0 +1,66 @@
+#ifndef SORTED_BATCH_H
+#define SORTED_BATCH_H
+
+#include "bin_eyt.h"
+#include "linear_search.h"
+#include "../util.h"
+
+#include <omp.h>
+#include <type_traits>
+
+// Bulk search of a sorted batch of keys. The answers of a sorted batch are in
+// ascending order, so each search only has to cover the distance (gap) from
+// the previous answer. Dense batches are merged linearly with the records,
+// batches with a gap below sqrt(size) use the finger search of the algorithm
+// (search_from, O(log gap)) and sparser batches search each key on its own.
+// The batch is split in n_thds contiguous parts searched in parallel, each
+// part starts with a full search.
+
+// Whether the records of an algorithm are in sorted order, which the merge
+// needs.
+template <class SearchAlgorithm> struct SortedLayout : std::true_type {};
+template <int record_bytes, bool prefetch, typename Index, class Stats>
+struct SortedLayout<b_eyt<record_bytes, prefetch, Index, Stats>>
+    : std::false_type {};
+
+// Batches with at least one key per merge_gap records are merged.
+constexpr long merge_gap = 16;
+
+enum class BatchMode { Merge, Finger, Search };
+
+template <class SearchAlgorithm>
+void search_sorted_batch(SearchAlgorithm &searchAlgorithm, const Key *keys,
+                         const long n, Index *out, const int n_thds = 1) {
+  const auto &records = searchAlgorithm.records();
+  const long gap = records.size() / std::max(n, 1L);
+  const BatchMode mode =
+      SortedLayout<SearchAlgorithm>::value && gap <= merge_gap
+          ? BatchMode::Merge
+          : gap * gap < (long)records.size() ? BatchMode::Finger
+                                             : BatchMode::Search;
+  using Linear = LinearUnroll<std::decay_t<decltype(records)>>;
+
+#pragma omp parallel num_threads(n_thds)
+  {
+    const int tid = omp_get_thread_num(), n_parts = omp_get_num_threads();
+    const long begin = n * tid / n_parts, end = n * (tid + 1) / n_parts;
+    if (begin < end) {
+      Index ix = out[begin] = searchAlgorithm.search(keys[begin]);
+      for (long i = begin + 1; i < end; i++) {
+        assert(keys[i - 1] <= keys[i]);
+        if (mode == BatchMode::Merge)
+          // the previous answer is <= keys[i], and the padding stops the
+          // search at the end
+          ix = records[ix] >= keys[i] ? ix
+                                      : Linear::forward(records, ix, keys[i]);
+        else if (mode == BatchMode::Finger)
+          ix = searchAlgorithm.search_from(ix, keys[i]);
+        else
+          ix = searchAlgorithm.search(keys[i]);
+        out[i] = ix;
+      }
+    }
+  }
+}
+
+#endif //SORTED_BATCH_H
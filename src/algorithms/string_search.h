@@ -0,0 +1,158 @@
+#ifndef STRING_SEARCH_H
+#define STRING_SEARCH_H
+
+#include "../string_keys.h"
+#include "../util.h"
+
+#include <string_view>
+
+// Binary Search, SIP and Eytzinger search of StringKeys. They compare the
+// 8 byte inline prefixes of the records and only compare the whole keys when
+// the prefixes tie. search() returns the position in records() of the first
+// key >= x.
+
+class StringBinary {
+  const StringKeys &A;
+
+ public:
+  StringBinary(const StringKeys &a) : A(a) {}
+
+  // Branch-free lower bound over [first, first + n).
+  __attribute__((always_inline)) Index
+  lower_bound(const StringKeys::Probe &q, Index first, Index n) const {
+    const StringKeys::Record *base = A.data() + first;
+    while (n > 1) {
+      const Index half = n / 2;
+      base = A.less(base[half], q) ? base + half : base;
+      n -= half;
+    }
+    return base - A.data() + (n == 1 && A.less(*base, q));
+  }
+
+  __attribute__((always_inline)) Index search(const std::string_view x) const {
+    const auto q = A.probe(x);
+    if (q.side != 0)
+      return q.side < 0 ? 0 : A.size();
+    return lower_bound(q, 0, A.size());
+  }
+
+  const StringKeys &records() const { return A; }
+
+  // Bytes held besides the records searched.
+  size_t aux_bytes() const { return sizeof(*this); }
+};
+
+// SIP on the prefixes: interpolates with the slope of the whole array, as a
+// double since the prefixes use all 64 bits, and searches linearly once the
+// bounds are within 2 * guard_off. Interpolation cannot tell apart keys whose
+// prefixes tie, so a probe of the same prefix as x, or max_probes probes
+// without narrowing the bounds enough, fall back to Binary Search of the
+// bounds.
+template <int guard_off = 8, int max_probes = 8> class StringSip {
+  const StringKeys &A;
+  const StringBinary binary;
+  const double slope;
+
+  Index interpolate(const uint64_t x, const Index mid) const {
+    const uint64_t p = A.record(mid).prefix;
+    return x < p ? mid - (Index)((double)(p - x) * slope)
+                 : mid + (Index)((double)(x - p) * slope);
+  }
+
+ public:
+  StringSip(const StringKeys &a)
+      : A(a), binary(a),
+        slope(a.size() < 2 || a.record(a.size() - 1).prefix == a.record(0).prefix
+                  ? 0.0
+                  : (double)(a.size() - 1) /
+                        (double)(a.record(a.size() - 1).prefix -
+                                 a.record(0).prefix)) {}
+
+  __attribute__((always_inline)) Index search(const std::string_view x) const {
+    const auto q = A.probe(x);
+    if (q.side != 0)
+      return q.side < 0 ? 0 : A.size();
+    Index left = 0, right = A.size() - 1;
+    Index next = std::min(
+        right, (Index)((q.prefix - std::min(q.prefix, A.record(0).prefix)) *
+                       slope));
+    for (int i = 0; i < max_probes; i++) {
+      const int c = A.compare(A.record(next), q);
+      if (c < 0)
+        left = next + 1;
+      else if (c > 0)
+        right = next - 1;
+      else
+        return next;
+      if (left > right)
+        return left;
+      // linear search base case
+      if (right - left < 2 * guard_off) {
+        while (left <= right && A.less(A.record(left), q))
+          left++;
+        return left;
+      }
+      if (A.record(next).prefix == q.prefix)
+        break;
+      next = std::min(std::max(interpolate(q.prefix, next), left), right);
+    }
+    return binary.lower_bound(q, left, right - left + 1);
+  }
+
+  const StringKeys &records() const { return A; }
+
+  size_t aux_bytes() const { return sizeof(*this); }
+};
+
+// Eytzinger layout of the records, with prefetching. The records are copied
+// to the new order, the bytes of the keys are shared with the sorted ones.
+template <bool prefetch = true> class StringEyt {
+  StringKeys A;
+
+  static Index copy_data(const StringKeys &in, Index j, const size_t i,
+                         StringKeys &out) {
+    if (i >= out.size())
+      return j;
+    j = copy_data(in, j, 2 * i + 1, out);
+    out.record(i) = in.record(j++);
+    return copy_data(in, j, 2 * i + 2, out);
+  }
+
+ public:
+  StringEyt(const StringKeys &in) : A(in) { copy_data(in, 0, 0, A); }
+
+  // Returns the position of the first key >= x in records(), or Index(-1) if
+  // there is none.
+  __attribute__((always_inline)) Index search(const std::string_view x) const {
+    const auto q = A.probe(x);
+    const StringKeys::Record *r = A.data();
+    const uint64_t n = A.size();
+    uint64_t i = 0;
+    if (q.side > 0)
+      return Index(-1);
+    if (q.side < 0) {
+      // the leftmost node
+      while (2 * i + 1 < n)
+        i = 2 * i + 1;
+      return i;
+    }
+    while (i < n) {
+      // the 8 descendants 3 levels down span two or three cache lines
+      if (prefetch) {
+        __builtin_prefetch(r + 8 * i + 7);
+        __builtin_prefetch(r + 8 * i + 11);
+        __builtin_prefetch(r + 8 * i + 14);
+      }
+      i = A.less(r[i], q) ? 2 * i + 2 : 2 * i + 1;
+    }
+    const uint64_t j = (i + 1) >> __builtin_ffsl(~(i + 1));
+    return j - 1;
+  }
+
+  const StringKeys &records() const { return A; }
+
+  // Bytes held besides the records searched, the Eytzinger copy of them.
+  size_t aux_bytes() const { return sizeof(*this) + A.bytes_of_records(); }
+};
+
+#endif //STRING_SEARCH_H
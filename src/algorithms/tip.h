@@ -1,13 +1,16 @@
 #ifndef TIP_H
 #define TIP_H
 
+#include "../index_file.h"
+
 // Three Point Interpolation Search - TIP Search
-template <int record_bytes, int guard_off>
+template <int record_bytes, int guard_off, class Stats = NoStats>
 class tip {
   using Vector = PaddedVector<record_bytes>;
   using Linear = LinearUnroll<Vector>;
 
   const Vector &data;
+  [[no_unique_address]] Stats lookup_stats;
 
   //// Interpolator //////////////////
   const Index d;
@@ -15,7 +18,10 @@ class tip {
   const double diff_y_01, a_0, diff_scale, d_a;
 
   Index interpolate(const Key y, const Index x_0, const Index x_1,
-                    const Index x_2) const {
+                    const Index x_2) {
+    lookup_stats.touch(&data[x_0]);
+    lookup_stats.touch(&data[x_1]);
+    lookup_stats.touch(&data[x_2]);
     double y_0 = data[x_0] - y, y_1 = data[x_1] - y, y_2 = data[x_2] - y,
         error = y_1 * (x_1 - x_2) * (x_1 - x_0) * (y_2 - y_0) /
         (y_2 * (x_1 - x_2) * (y_0 - y_1) +
@@ -30,11 +36,22 @@ class tip {
 
   ////////////////////////////////////
 
-  __attribute__((always_inline)) Key linear_search(const Key x, Index y) const {
+  // The constants computed at construction, saved in an IndexFile.
+  struct Saved {
+    Index d;
+    Key y_1;
+    double diff_y_01, a_0, diff_scale, d_a;
+  };
+
+  tip(const Vector &data, const Saved &s)
+      : data(data), d(s.d), y_1(s.y_1), diff_y_01(s.diff_y_01), a_0(s.a_0),
+        diff_scale(s.diff_scale), d_a(s.d_a) {}
+
+  __attribute__((always_inline)) Index linear_search(const Key x, Index y) {
     if (data[y] >= x) {
-      return data[Linear::reverse(data, y, x)];
+      return Linear::reverse(data, y, x, lookup_stats);
     } else {
-      return data[Linear::forward(data, y + 1, x)];
+      return Linear::forward(data, y + 1, x, lookup_stats);
     }
   }
 
@@ -53,48 +70,108 @@ class tip {
     assert(data.size() >= 1);
   }
 
-  __attribute__((always_inline)) Key search(const Key x) {
-    Index left = 0, right = data.size() - 1, next_1 = data.size() >> 1,
-        next_2 = interpolate(x);
-    while(true) {
-      if (next_2 - next_1 <= guard_off && next_2 - next_1 >= -guard_off)
-        return linear_search(x, next_2);
-      assert(next_1 >= left);
-      assert(next_1 <= right);
-      assert(next_2 >= left);
-      assert(next_2 <= right);
-      assert(next_1 != next_2);
-      if (data[next_1] != data[next_2]) {
-        if (next_1 < next_2) {
-          assert(data[next_1] <= x); // f(x) <= f(x') ==> x <= x'
-          left = next_1;
-        } else {
-          assert(data[next_1] >= x); // f(x) >= f(x') ==> x >= x'
-          right = next_1;
-        }
-        if (next_2 + guard_off >= right) {
-          auto r = data[Linear::reverse(data, right, x)];
-          return r;
-        } else if (next_2 - guard_off <= left) {
-          auto r = data[Linear::forward(data, left, x)];
-          return r;
-        }
-      }
-      next_1 = next_2;
-
-      assert(left < right);
-      assert(left >= 0);
-      assert(right < data.size());
-      assert(next_1 != left);
-      assert(next_1 != right);
-
-      next_2 = interpolate(x, left, next_1, right);
-
-      assert(next_2 >= left);
-      assert(next_2 <= right);
-    }
-    return linear_search(x, next_2);
+  static constexpr char index_name[] = "tip";
+
+  // Loads an index saved by save(), searching the records of the file.
+  tip(const IndexFile<record_bytes> &file)
+      : tip(file.records(), file.template section<Saved>(index_name)) {}
+
+  void save(const std::string &path) const {
+    typename IndexFile<record_bytes>::Writer out(path, index_name, data);
+    out.section(index_name,
+                Saved{d, y_1, diff_y_01, a_0, diff_scale, d_a});
+  }
+
+  // The search, shared by search() and search_coro(). PROBE(p) comes before
+  // each interpolation probe of the record at p and RETURN returns the
+  // result.
+#define TIP_SEARCH(PROBE, RETURN)                                              \
+  Index left = 0, right = data.size() - 1, next_1 = data.size() >> 1,          \
+      next_2 = interpolate(x);                                                 \
+  while(true) {                                                                \
+    if (next_2 - next_1 <= guard_off && next_2 - next_1 >= -guard_off) {       \
+      lookup_stats.guard();                                                    \
+      PROBE(&data[next_2]);                                                    \
+      RETURN linear_search(x, next_2);                                         \
+    }                                                                          \
+    assert(next_1 >= left);                                                    \
+    assert(next_1 <= right);                                                   \
+    assert(next_2 >= left);                                                    \
+    assert(next_2 <= right);                                                   \
+    assert(next_1 != next_2);                                                  \
+    lookup_stats.touch(&data[next_1]);                                         \
+    PROBE(&data[next_2]);                                                      \
+    if (data[next_1] != data[next_2]) {                                        \
+      if (next_1 < next_2) {                                                   \
+        assert(data[next_1] <= x); /* f(x) <= f(x') ==> x <= x' */             \
+        left = next_1;                                                         \
+      } else {                                                                 \
+        assert(data[next_1] >= x); /* f(x) >= f(x') ==> x >= x' */             \
+        right = next_1;                                                        \
+      }                                                                        \
+      if (next_2 + guard_off >= right) {                                       \
+        lookup_stats.guard();                                                  \
+        RETURN Linear::reverse(data, right, x, lookup_stats);                  \
+      } else if (next_2 - guard_off <= left) {                                 \
+        lookup_stats.guard();                                                  \
+        RETURN Linear::forward(data, left, x, lookup_stats);                   \
+      }                                                                        \
+    }                                                                          \
+    next_1 = next_2;                                                           \
+                                                                               \
+    assert(left < right);                                                      \
+    assert(left >= 0);                                                         \
+    assert(right < data.size());                                               \
+    assert(next_1 != left);                                                    \
+    assert(next_1 != right);                                                   \
+                                                                               \
+    next_2 = interpolate(x, left, next_1, right);                              \
+                                                                               \
+    assert(next_2 >= left);                                                    \
+    assert(next_2 <= right);                                                   \
+  }
+#define TIP_PROBE(p) lookup_stats.probe(Probe::Interpolation, p)
+
+  __attribute__((always_inline)) Index search(const Key x) {
+    TIP_SEARCH(TIP_PROBE, return)
+  }
+
+#ifdef CORO_SEARCH
+  // search() as a coroutine, yields before probing each new interpolation.
+#define TIP_PROBE_CORO(p) (TIP_PROBE(p), co_await Prefetch{p})
+  SearchTask search_coro(const Key x) {
+    TIP_SEARCH(TIP_PROBE_CORO, co_return)
+  }
+#endif
+
+  // Finger search, gallops from hint, such as the result of a previous
+  // search.
+  __attribute__((always_inline)) Index search_from(const Index hint,
+                                                   const Key x) {
+    return Gallop<Vector>::lower_bound(data, hint, x);
+  }
+
+  const Vector &records() const { return data; }
+
+  // The same search instrumented with the policy S, see lookup_stats.h.
+  template <class S> using with_stats = tip<record_bytes, guard_off, S>;
+  Stats &stats() { return lookup_stats; }
+
+  // Bytes held besides the records searched.
+  size_t aux_bytes() const { return sizeof(*this); }
+
+  // The positions of the first and one past the last record with key x.
+  std::pair<Index, Index> equal_range(const Key x) {
+    return Gallop<Vector>::equal_range(data, search(x), x);
+  }
+
+  Index count(const Key x) {
+    auto range = equal_range(x);
+    return range.second - range.first;
   }
 };
+#undef TIP_SEARCH
+#undef TIP_PROBE
+#undef TIP_PROBE_CORO
 
 #endif //TIP_H
@@ -0,0 +1,143 @@
+#ifndef VERSIONED_H
+#define VERSIONED_H
+
+#include "../padded_vector.h"
+#include "../util.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// An index that can be replaced while it is searched. The records and the
+// SearchAlgorithm built on them form a Snapshot. Readers pin the current
+// snapshot without taking locks, a builder constructs a new one on its own
+// thread and publishes it with one atomic swap, and a replaced snapshot is
+// freed once no reader can still hold it.
+//
+// Reclamation is epoch based: each reader has a slot where it announces the
+// global epoch while it holds a snapshot. Publishing swaps the snapshot, then
+// advances the epoch, and the old snapshot is retired with the epoch it was
+// current in. A retired snapshot is freed when every slot is idle or has
+// announced a later epoch.
+
+template <class SearchAlgorithm, int record_bytes>
+class VersionedIndex {
+  using Vector = PaddedVector<record_bytes>;
+
+ public:
+  struct Snapshot {
+    Vector records;
+    SearchAlgorithm searchAlgorithm;
+    const uint64_t version;
+
+    Snapshot(Vector &&records, const uint64_t version)
+        : records(std::move(records)), searchAlgorithm(this->records),
+          version(version) {}
+  };
+
+ private:
+  static constexpr uint64_t idle = 0;
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{idle};
+  };
+
+  struct Retired {
+    Snapshot *snapshot;
+    uint64_t epoch;
+  };
+
+  std::atomic<Snapshot *> current;
+  std::atomic<uint64_t> epoch;
+  std::vector<Slot> slots;
+  // of the builder
+  std::vector<Retired> retired;
+  uint64_t versions, reclaimed_snapshots;
+
+ public:
+  // A snapshot pinned by a reader, until its destruction.
+  class Pinned {
+    Slot &slot;
+    Snapshot *snapshot;
+
+   public:
+    Pinned(Slot &slot, Snapshot *snapshot) : slot(slot), snapshot(snapshot) {}
+    ~Pinned() { slot.epoch.store(idle, std::memory_order_release); }
+    Pinned(const Pinned &) = delete;
+    Pinned &operator=(const Pinned &) = delete;
+
+    Snapshot *operator->() const { return snapshot; }
+    Snapshot &operator*() const { return *snapshot; }
+  };
+
+  // For n_readers readers, numbered from 0, with the first snapshot built
+  // from records.
+  VersionedIndex(Vector records, const int n_readers)
+      : current(new Snapshot(std::move(records), 1)), epoch(1),
+        slots(n_readers), versions(1), reclaimed_snapshots(0) {}
+
+  ~VersionedIndex() {
+    for (auto &r : retired)
+      delete r.snapshot;
+    delete current.load();
+  }
+
+  VersionedIndex(const VersionedIndex &) = delete;
+  VersionedIndex &operator=(const VersionedIndex &) = delete;
+
+  // Pins the current snapshot for reader. The announcement of the epoch is
+  // ordered before the load of the snapshot (seq_cst), so a builder that
+  // swapped it out sees the reader in its slot.
+  __attribute__((always_inline)) Pinned pin(const int reader) {
+    Slot &slot = slots[reader];
+    slot.epoch.store(epoch.load(std::memory_order_acquire),
+                     std::memory_order_seq_cst);
+    return Pinned(slot, current.load(std::memory_order_seq_cst));
+  }
+
+  // Called by a single builder thread: builds a snapshot of records and
+  // makes it the current one, then frees the retired snapshots no reader
+  // holds anymore. Returns the version of the new snapshot.
+  uint64_t publish(Vector records) {
+    Snapshot *next = new Snapshot(std::move(records), ++versions);
+    Snapshot *old = current.exchange(next, std::memory_order_seq_cst);
+    retired.push_back({old, epoch.fetch_add(1, std::memory_order_seq_cst)});
+    reclaim();
+    return next->version;
+  }
+
+  // Frees the retired snapshots that every reader has moved past.
+  void reclaim() {
+    uint64_t oldest = UINT64_MAX;
+    for (auto &s : slots) {
+      const uint64_t e = s.epoch.load(std::memory_order_seq_cst);
+      if (e != idle)
+        oldest = std::min(oldest, e);
+    }
+    auto held = std::partition(retired.begin(), retired.end(),
+                               [&](const Retired &r) {
+                                 return r.epoch >= oldest;
+                               });
+    for (auto it = held; it != retired.end(); it++)
+      delete it->snapshot;
+    reclaimed_snapshots += retired.end() - held;
+    retired.erase(held, retired.end());
+  }
+
+  uint64_t version() const { return current.load()->version; }
+  // Snapshots replaced but not yet freed, and freed.
+  size_t pending() const { return retired.size(); }
+  uint64_t reclaimed() const { return reclaimed_snapshots; }
+
+  // Bytes held besides the records of the dataset: the current snapshot with
+  // its copy of the records, and the reader slots.
+  size_t aux_bytes() const {
+    const Snapshot *s = current.load();
+    return sizeof(*this) + slots.capacity() * sizeof(Slot) + sizeof(*s) +
+           s->records.bytes() + s->searchAlgorithm.aux_bytes() -
+           sizeof(s->searchAlgorithm);
+  }
+};
+
+#endif //VERSIONED_H
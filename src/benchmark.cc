@@ -1,6 +1,7 @@
 #include "benchmark.h"
 #include "datasets.h"
 #include "benchmark_utils.h"
+#include "machine_profile.h"
 #include "util.h"
 
 #include <algorithm>
@@ -23,12 +24,35 @@
 
 
 // Takes one argument, a tsv file with the specification of the experiment to
-// run.
+// run, and optionally the number of one row of the file (from 0) to run only
+// that experiment, e.g. to profile it.
 int main(int argc, char *argv[]) {
-  using RunTuple = std::tuple<DatasetParam::Tuple, std::string, int>;
+  using RunTuple =
+      std::tuple<DatasetParam::Tuple, std::string, int, std::string>;
 
   // Load the experiment specification from the Dataset file
   std::vector<Run> runs = loadRunsFromFile(std::ifstream(argv[1]));
+  int run_ix = 0;
+  if (argc > 2) {
+    run_ix = parse2<int>(argv[2]);
+    if (run_ix < 0 || run_ix >= (int)runs.size()) {
+      std::cerr << "No experiment " << argv[2] << " in " << argv[1] << '\n';
+      return EXIT_FAILURE;
+    }
+    runs = {runs[run_ix]};
+  }
+
+  // The profile of the host, see machine_profile.cc, TimeNS is also output in
+  // units of its DRAM latency.
+  const MachineProfile machine = MachineProfile::load();
+  if (machine.empty())
+    std::cerr << "No machine profile, run make machine_profile\n";
+  else {
+    std::cerr << "Machine profile:";
+    for (auto &m : machine.metrics)
+      std::cerr << ' ' << m.first << '=' << m.second;
+    std::cerr << '\n';
+  }
 
   // create the Dataset needed by the experiments
   DatasetBase::DatasetMap datasets_map;
@@ -38,7 +62,7 @@ int main(int argc, char *argv[]) {
 
   // Run the experiments
   bool first = true;
-  int run_ix = 0;
+  const int first_ix = run_ix;
 
   RunTuple old_param;
   auto t0 = std::chrono::steady_clock::now();
@@ -47,26 +71,33 @@ int main(int argc, char *argv[]) {
     auto param = run.dataset_param.param;
     auto n = run.dataset_param.n;
     auto record_bytes = run.dataset_param.record_bytes;
-    RunTuple new_param{run.dataset_param, run.name, run.n_thds};
+    RunTuple new_param{run.dataset_param, run.name, run.n_thds, run.queries};
     if (new_param != old_param) {
       std::cerr << "Running experiment: ";
       std::cerr << n << ' ' << distribution << ' ' << param << ' '
-                << record_bytes << ' ' << run.name << ' ' << run.n_thds << '\n';
+                << record_bytes << ' ' << run.name << ' ' << run.n_thds
+                << (run.queries.empty() ? "" : " " + run.queries) << '\n';
       old_param = new_param;
-      if (run_ix == 0) {
+      if (run_ix == first_ix) {
         std::cout << std::setw(3) << "Run\t" << std::setw(11) << "DatasetSize\t"
                   << std::setw(12) << "Distribution\t" << std::setw(10)
                   << "Parameter\t" << std::setw(8) << "#threads\t"
                   << std::setw(15) << "SearchAlgorithm\t" << std::setw(15)
                   << "RecordSizeBytes\t" << std::setw(6) << "TimeNS\t"
-                  << "\n";
+                  << std::setw(10) << "BuildNS\t" << std::setw(10)
+                  << "AuxBytes\t" << std::setw(8) << "PeakRSSDeltaKB\t"
+                  << std::setw(6) << "ISA\t" << std::setw(8) << "DRAMLatencies\t"
+                  << std::setw(10) << "FirstLookupNS\t" << "\n";
       } else {
         std::cerr << std::setw(3) << "Run\t" << std::setw(11) << "DatasetSize\t"
                   << std::setw(12) << "Distribution\t" << std::setw(10)
                   << "Parameter\t" << std::setw(8) << "#threads\t"
                   << std::setw(15) << "SearchAlgorithm\t" << std::setw(15)
                   << "RecordSizeBytes\t" << std::setw(6) << "TimeNS\t"
-                  << "\n";
+                  << std::setw(10) << "BuildNS\t" << std::setw(10)
+                  << "AuxBytes\t" << std::setw(8) << "PeakRSSDeltaKB\t"
+                  << std::setw(6) << "ISA\t" << std::setw(8) << "DRAMLatencies\t"
+                  << std::setw(10) << "FirstLookupNS\t" << "\n";
       }
     }
 
@@ -83,6 +114,13 @@ int main(int argc, char *argv[]) {
                 << std::setw(8) << run.n_thds << "\t" << std::setw(15)
                 << run.name.c_str() << "\t" << std::setw(15) << record_bytes
                 << "\t" << std::setw(6) << std::setprecision(5) << ns << "\t"
+                << std::setw(10) << std::setprecision(10) << run.build_ns
+                << "\t" << std::setw(10) << run.aux_bytes << "\t"
+                << std::setw(8) << run.peak_rss_delta_kb << "\t"
+                << std::setw(6) << run.isa << "\t" << std::setw(8)
+                << std::setprecision(5) << ns / machine.dram_latency_ns()
+                << "\t" << std::setw(10) << std::setprecision(10)
+                << run.first_lookup_ns << "\t"
                 << "\n";
     }
     run_ix++;
@@ -6,9 +6,28 @@
 #include "algorithms/binary_search.h"
 #include "algorithms/linear_search.h"
 #include "algorithms/interpolation_search.h"
+#include "algorithms/interpolation_binary.h"
 #include "algorithms/tip.h"
 #include "algorithms/sip.h"
 #include "algorithms/bin_eyt.h"
+#include "algorithms/binary_simd.h"
+#include "algorithms/external.h"
+#include "algorithms/filtered.h"
+#include "algorithms/partitioned.h"
+#include "algorithms/sharded.h"
+#include "algorithms/sorted_batch.h"
+#include "algorithms/string_search.h"
+#include "algorithms/versioned.h"
+#include "index_file.h"
+#include "mapped_file.h"
+#include "memory_usage.h"
+#include "isa.h"
+#include "latency.h"
+#include "payload.h"
+#include "profiler.h"
+#include "query_source.h"
+#include "range_scan.h"
+#include "perf_counters.h"
 #include "omp.h"
 #include "util.h"
 
@@ -24,6 +43,7 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <memory>
@@ -33,32 +53,121 @@ using fn_tuple = std::tuple<const char *, Fn *>;
 using std::make_tuple;
 
 struct Run {
+  static constexpr int sample_size = 1000;
+
   DatasetParam dataset_param;
-  std::string name;
+  // name is the SearchAlgorithm column: the algorithm followed by its
+  // comma separated parameters, e.g. "parts-sip,1000".
+  std::string name, algorithm;
+  std::vector<std::string> params;
   int n_thds;
+  // The trace of probe keys, see QuerySource, empty for the permuted keys of
+  // the dataset.
+  std::string queries;
   bool ok;
+  // Cost of the construction of the search algorithm: wall time, bytes held
+  // besides the records (aux_bytes()) and growth of the peak RSS.
+  double build_ns;
+  size_t aux_bytes;
+  long peak_rss_delta_kb;
+  // From the start of the construction to the answer of the first lookup,
+  // nan for the entries that do not measure it.
+  double first_lookup_ns;
+  // The instruction set of the search kernel, see isa.h.
+  const char *isa;
 
-  Run(DatasetParam dataset_param, std::string name, int n_thds)
-      : dataset_param(dataset_param), name(name), n_thds(n_thds), ok(true) {}
+  Run(DatasetParam dataset_param, std::string name, int n_thds,
+      std::string queries = "")
+      : dataset_param(dataset_param), name(name), n_thds(n_thds),
+        queries(queries), ok(true),
+        build_ns(0), aux_bytes(0), peak_rss_delta_kb(0), first_lookup_ns(NAN),
+        isa(isa_name(Isa::Base)) {
+    params = split(name);
+    algorithm = params.front();
+    params.erase(params.begin());
+  }
 
-  template<typename SearchAlgorithm, int record_bytes>
-  static std::vector<double> searchAndMeasure(Run &run,
-                                              const DatasetBase &dataset) {
-    const auto
-        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+  // The experiment row of the run, e.g. for profiler markers.
+  std::string label() const {
+    std::stringstream s;
+    s << dataset_param.n << ' ' << dataset_param.distribution << ' '
+      << dataset_param.param << ' ' << dataset_param.record_bytes << ' '
+      << name << ' ' << n_thds;
+    return s.str();
+  }
+
+  // Profiles the timed loop of a run, from its construction to its
+  // destruction, when searchbench runs under perf with PerfControl.
+  class ProfiledRegion {
+    const std::string label;
+
+   public:
+    ProfiledRegion(const Run &run) : label(run.label()) {
+      PerfControl::get().enable(label);
+    }
+    ~ProfiledRegion() { PerfControl::get().disable(label); }
+  };
+
+  // Measures a construction, from the construction of the meter to the call
+  // of done() with the algorithm built.
+  class BuildMeter {
+    Run &run;
+    long rss_kb;
+    std::chrono::steady_clock::time_point t0;
+
+   public:
+    BuildMeter(Run &run)
+        : run(run), rss_kb(peak_rss_baseline_kb()),
+          t0(std::chrono::steady_clock::now()) {}
+
+    void done(const size_t aux_bytes) {
+      run.build_ns =
+          std::chrono::nanoseconds(std::chrono::steady_clock::now() - t0)
+              .count();
+      run.peak_rss_delta_kb = peak_rss_kb() - rss_kb;
+      run.aux_bytes = aux_bytes;
+    }
+
+    template <class SearchAlgorithm>
+    void done(const SearchAlgorithm &searchAlgorithm) {
+      done(searchAlgorithm.aux_bytes());
+    }
+
+    // After done(), searches x as the first lookup, returns its record.
+    template <class SearchAlgorithm>
+    Key first_lookup(SearchAlgorithm &searchAlgorithm, const Key x) {
+      const Key val = searchAlgorithm.records()[searchAlgorithm.search(x)];
+      run.first_lookup_ns =
+          std::chrono::nanoseconds(std::chrono::steady_clock::now() - t0)
+              .count();
+      return val;
+    }
+  };
+
+  // Times `search_sample(first_query)` over subsets of sample_size queries.
+  // Each thread visits all n_samples subsets, thread 0 in order and the rest
+  // in a shuffled order. search_sample returns the checksum of the subset,
+  // the checksums of a thread must add up to expected_sum.
+  template<typename SearchSample>
+  static std::vector<double> measureSamples(Run &run, const int n_samples,
+                                            const unsigned long expected_sum,
+                                            SearchSample &&search_sample) {
+    return measureSamples(run, n_samples, expected_sum, [](int) {},
+                          search_sample);
+  }
+
+  // As above, with an untimed call to prepare_sample(first_query) before each
+  // subset.
+  template<typename PrepareSample, typename SearchSample>
+  static std::vector<double> measureSamples(Run &run, const int n_samples,
+                                            const unsigned long expected_sum,
+                                            PrepareSample &&prepare_sample,
+                                            SearchSample &&search_sample) {
 #ifdef INFINITE_REPEAT
     constexpr bool infinite_repeat = true;
 #else
     constexpr bool infinite_repeat = false;
 #endif
-    constexpr int sample_size = 1000;
-    const int n_samples = inputDataset.keys.size() / sample_size;
-    auto &keys_to_search_for = inputDataset.permuted_keys;
-
-    // TODO this can't be a template of a template have to specialize earlier
-    // have to specialize in the class itself. Maybe template macros?
-    SearchAlgorithm searchAlgorithm(inputDataset.keys);
-
     //Stores the times to search each subset
     std::vector<double> ns(n_samples * run.n_thds);
     // Stores the start of each subset in keys_to_search_for
@@ -73,11 +182,12 @@ struct Run {
 
     // make copy to pass it easier in the parallel region as
     // private copy (firstprivate)
-    const auto inputsum = inputDataset.sum;
+    const auto inputsum = expected_sum;
 
+    ProfiledRegion profiled(run);
 #pragma omp parallel default(none)                                             \
     num_threads(run.n_thds) firstprivate(n_samples, inputsum) \
-    shared(keys_to_search_for, run, searchAlgorithm, ns, subset_indexes)
+    shared(run, prepare_sample, search_sample, ns, subset_indexes)
     {
       const int tid = omp_get_thread_num();
       const auto &thread_ns = &ns[tid * n_samples];
@@ -92,13 +202,9 @@ struct Run {
         int query_index =
             subset_indexes[tid * n_samples + sample_index] * sample_size;
 
+        prepare_sample(query_index);
         auto t0 = std::chrono::steady_clock::now();
-        for (int i = query_index; i < query_index + sample_size; i++) {
-          auto val = searchAlgorithm.search(keys_to_search_for[i]);
-          valSum += val;
-          assert(val == keys_to_search_for[i]);
-        }
-
+        valSum += search_sample(query_index);
         auto t1 = std::chrono::steady_clock::now();
         double ns_elapsed = std::chrono::nanoseconds(t1 - t0).count();
         // thread_ns[0] += ns_elapsed;
@@ -111,35 +217,1219 @@ struct Run {
     return ns;
   }
 
+  // The search of a subset in searchAndMeasure, returns its checksum. It is
+  // compiled for each Isa by the wrappers below, which inline the whole search
+  // into themselves (flatten).
+  template<typename SearchAlgorithm>
+  static __attribute__((always_inline)) unsigned long
+  searchSample(SearchAlgorithm &searchAlgorithm, const Key *keys) {
+    const auto &records = searchAlgorithm.records();
+    auto valSum = 0UL;
+    for (int i = 0; i < sample_size; i++) {
+      auto val = records[searchAlgorithm.search(keys[i])];
+      valSum += val;
+      assert(val == keys[i]);
+    }
+    return valSum;
+  }
+
+  template<typename SearchAlgorithm>
+  static __attribute__((flatten)) unsigned long
+  searchSampleBase(SearchAlgorithm &searchAlgorithm, const Key *keys) {
+    return searchSample(searchAlgorithm, keys);
+  }
+
+  template<typename SearchAlgorithm>
+  static ISA_TARGET_AVX2 __attribute__((flatten)) unsigned long
+  searchSampleAVX2(SearchAlgorithm &searchAlgorithm, const Key *keys) {
+    return searchSample(searchAlgorithm, keys);
+  }
+
+  template<typename SearchAlgorithm>
+  static ISA_TARGET_AVX512 __attribute__((flatten)) unsigned long
+  searchSampleAVX512(SearchAlgorithm &searchAlgorithm, const Key *keys) {
+    return searchSample(searchAlgorithm, keys);
+  }
+
+  // The search of a subset of a trace, the queries may be absent from the
+  // records. Writes the position found of each key to out, the checksum adds
+  // the keys found. Keys outside of [lo, hi] are clamped, as not all
+  // algorithms handle them: keys below lo are searched as lo, keys above hi
+  // are at n, past the end, as in RangeQuery::lower_bound. The clamping is
+  // timed with the searches.
+  template<typename SearchAlgorithm>
+  static __attribute__((always_inline)) unsigned long
+  traceSample(SearchAlgorithm &searchAlgorithm, const Key *keys, const Key lo,
+              const Key hi, Index *out) {
+    const auto &records = searchAlgorithm.records();
+    const Index n = records.size();
+    auto valSum = 0UL;
+    for (int i = 0; i < sample_size; i++) {
+      const Key x = keys[i];
+      const Index pos =
+          x > hi ? n : (Index)searchAlgorithm.search(std::max(x, lo));
+      out[i] = pos;
+      valSum += pos < n && records[pos] == x ? x : 0;
+    }
+    return valSum;
+  }
+
+  template<typename SearchAlgorithm>
+  static __attribute__((flatten)) unsigned long
+  traceSampleBase(SearchAlgorithm &searchAlgorithm, const Key *keys,
+                  const Key lo, const Key hi, Index *out) {
+    return traceSample(searchAlgorithm, keys, lo, hi, out);
+  }
+
+  template<typename SearchAlgorithm>
+  static ISA_TARGET_AVX2 __attribute__((flatten)) unsigned long
+  traceSampleAVX2(SearchAlgorithm &searchAlgorithm, const Key *keys,
+                  const Key lo, const Key hi, Index *out) {
+    return traceSample(searchAlgorithm, keys, lo, hi, out);
+  }
+
+  template<typename SearchAlgorithm>
+  static ISA_TARGET_AVX512 __attribute__((flatten)) unsigned long
+  traceSampleAVX512(SearchAlgorithm &searchAlgorithm, const Key *keys,
+                    const Key lo, const Key hi, Index *out) {
+    return traceSample(searchAlgorithm, keys, lo, hi, out);
+  }
+
+  // Whether pos, a position in the records of the algorithm, answers the
+  // search of x: it holds x when x is a key, otherwise one of the keys around
+  // x, the first key > x or the last key < x, depending on the algorithm, or
+  // it is n when no key is >= x. In a sorted layout the record of a miss must
+  // also be next to x: the record before the first key > x is < x, the one
+  // after the last key < x is > x.
+  template<typename SearchAlgorithm, class Vector>
+  static bool validPosition(const SearchAlgorithm &searchAlgorithm,
+                            const Vector &keys, const Key x, const Index pos) {
+    const auto &records = searchAlgorithm.records();
+    const Index n = records.size();
+    constexpr bool sorted = SortedLayout<SearchAlgorithm>::value;
+    auto it = std::lower_bound(keys.begin(), keys.end(), x,
+                               [](Key a, Key b) { return a < b; });
+    if (it == keys.end())
+      return pos == n;
+    if (pos >= n)
+      return false;
+    if (*it == x || x < keys[0])
+      return records[pos] == *it;
+    if (records[pos] == *it)
+      return !sorted || pos == 0 || records[pos - 1] < x;
+    return it != keys.begin() && records[pos] == *(it - 1) &&
+           (!sorted || pos + 1 == n || records[pos + 1] > x);
+  }
+
+  // Searches the subsets of a trace (QuerySource) split between the threads.
+  // Every key is searched, those outside of the records clamped. After each
+  // subset is timed, the keys found must add up to those std::lower_bound
+  // finds on the keys of the dataset, and each position is checked with
+  // validPosition.
+  template<typename SearchAlgorithm, class Vector>
+  static std::vector<double> traceAndMeasure(Run &run, const Vector &keys,
+                                             const QuerySource &queries,
+                                             SearchAlgorithm &searchAlgorithm) {
+    const int n_samples = queries.size() / sample_size;
+    const Key lo = keys[0], hi = keys.back();
+
+    std::vector<unsigned long> expected(n_samples);
+    long hits = 0, outside = 0;
+    for (int s = 0; s < n_samples; s++)
+      for (long i = (long)s * sample_size; i < (long)(s + 1) * sample_size;
+           i++) {
+        const Key x = queries.data()[i];
+        outside += x < lo || x > hi;
+        auto it = std::lower_bound(keys.begin(), keys.end(), x,
+                                   [](Key a, Key b) { return a < b; });
+        if (it != keys.end() && *it == x) {
+          expected[s] += x;
+          hits++;
+        }
+      }
+    const double n_queries = (double)n_samples * sample_size;
+    std::cerr << "Queries: " << n_samples * (long)sample_size
+              << " of a trace, hit ratio " << hits / n_queries
+              << ", outside of the keys " << outside / n_queries
+              << ", split " << queries.split_name() << '\n';
+
+    const auto kernel =
+        dispatch(traceSampleBase<SearchAlgorithm>,
+                 traceSampleAVX2<SearchAlgorithm>,
+                 traceSampleAVX512<SearchAlgorithm>);
+    run.isa = isa_name(selected_isa());
+
+    std::vector<double> ns(n_samples);
+    TeamCacheMisses misses(run.n_thds);
+    ProfiledRegion profiled(run);
+#pragma omp parallel num_threads(run.n_thds)
+    {
+      bool ok = true;
+      std::vector<Index> out(sample_size);
+      for (int s : queries.subsets_of(omp_get_thread_num(), run.n_thds,
+                                      n_samples)) {
+        const Key *subset = queries.data() + (long)s * sample_size;
+        auto t0 = std::chrono::steady_clock::now();
+        auto valSum = kernel(searchAlgorithm, subset, lo, hi, out.data());
+        auto t1 = std::chrono::steady_clock::now();
+        ns[s] = std::chrono::nanoseconds(t1 - t0).count() /
+                (double)sample_size;
+        ok = ok && valSum == expected[s];
+        for (int i = 0; ok && i < sample_size; i++)
+          ok = validPosition(searchAlgorithm, keys, subset[i], out[i]);
+      }
+#pragma omp critical
+      run.ok = run.ok && ok;
+    }
+    reportCacheMisses(misses, (double)n_samples * sample_size);
+    return ns;
+  }
+
+  // Searches the queries of the run (QuerySource): the keys of the dataset in
+  // random order, or a trace.
   template<typename SearchAlgorithm, int record_bytes>
-  static std::vector<double> searchAndMetadata(Run &run,
+  static std::vector<double> searchAndMeasure(Run &run,
                                               const DatasetBase &dataset) {
     const auto
         &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const int n_samples = inputDataset.keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+    const QuerySource queries = run.queries.empty()
+                                    ? QuerySource(keys_to_search_for)
+                                    : QuerySource(run.queries);
 
-    sip<record_bytes> searchAlgorithm(inputDataset.keys);
+    BuildMeter meter(run);
+    // TODO this can't be a template of a template have to specialize earlier
+    // have to specialize in the class itself. Maybe template macros?
+    SearchAlgorithm searchAlgorithm(inputDataset.keys);
+    meter.done(searchAlgorithm);
+    run.ok = run.ok && meter.first_lookup(searchAlgorithm, keys_to_search_for[0]) ==
+             keys_to_search_for[0];
+    if (queries.is_trace())
+      return traceAndMeasure(run, inputDataset.keys, queries, searchAlgorithm);
+
+    const auto kernel =
+        dispatch(searchSampleBase<SearchAlgorithm>,
+                 searchSampleAVX2<SearchAlgorithm>,
+                 searchSampleAVX512<SearchAlgorithm>);
+    run.isa = isa_name(selected_isa());
 
-    std::vector<std::pair<int, int>> res;
+    TeamCacheMisses misses(run.n_thds);
+    auto ns = measureSamples(run, n_samples, inputDataset.sum, [&](int first) {
+      return kernel(searchAlgorithm, queries.data() + first);
+    });
+    reportCacheMisses(misses, (double)n_samples * sample_size * run.n_thds);
+    return ns;
+  }
 
-    long iterations = 0;
-    long steps = 0;
+  // Saves the algorithm built on the dataset to an index file, then loads it
+  // by mapping the file and searches the records where they are mapped.
+  // BuildNS is the time to map the file and construct the algorithm on it,
+  // FirstLookupNS adds the first lookup. The time to first lookup when
+  // building from the records in memory is reported on stderr. Parameter:
+  // "warm" (default), or "cold" to drop the file from the page cache before
+  // loading it.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> loadAndMeasure(Run &run,
+                                            const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const int n_samples = inputDataset.keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+    const bool cold = run.params.size() > 0 && run.params[0] == "cold";
+
+    char path[] = "/tmp/searchbench_indexXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    double rebuild_ns;
+    {
+      BuildMeter meter(run);
+      SearchAlgorithm built(inputDataset.keys);
+      meter.done(built);
+      meter.first_lookup(built, keys_to_search_for[0]);
+      rebuild_ns = run.first_lookup_ns;
+      built.save(path);
+    }
+    if (cold)
+      IndexFile<record_bytes>(path, SearchAlgorithm::index_name).evict();
+
+    BuildMeter meter(run);
+    IndexFile<record_bytes> file(path, SearchAlgorithm::index_name);
+    SearchAlgorithm searchAlgorithm(file);
+    meter.done(searchAlgorithm);
+    run.ok = run.ok && meter.first_lookup(searchAlgorithm,
+                                          keys_to_search_for[0]) ==
+                           keys_to_search_for[0];
+    unlink(path);
+    std::cerr << "Index file: " << file.bytes() << " bytes, first lookup "
+              << run.first_lookup_ns / 1e3 << " us loaded, "
+              << rebuild_ns / 1e3 << " us rebuilt\n";
+
+    const auto kernel =
+        dispatch(searchSampleBase<SearchAlgorithm>,
+                 searchSampleAVX2<SearchAlgorithm>,
+                 searchSampleAVX512<SearchAlgorithm>);
+    run.isa = isa_name(selected_isa());
+    return measureSamples(run, n_samples, inputDataset.sum, [&](int first) {
+      return kernel(searchAlgorithm, keys_to_search_for.data() + first);
+    });
+  }
+
+  // Times each lookup on its own, each value is the p99 latency of the
+  // lookups of a subset instead of their mean. The percentiles over all the
+  // lookups are reported on stderr.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> tailAndMeasure(Run &run,
+                                            const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const int n_samples = inputDataset.keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+
+    BuildMeter meter(run);
+    SearchAlgorithm searchAlgorithm(inputDataset.keys);
+    meter.done(searchAlgorithm);
+    const auto &records = searchAlgorithm.records();
+
+    std::vector<LatencyHistogram> latencies(run.n_thds);
+    std::vector<std::vector<double>> p99(run.n_thds);
+    measureSamples(run, n_samples, inputDataset.sum, [&](int first) {
+      const int tid = omp_get_thread_num();
+      LatencyHistogram sample;
+      auto valSum = 0UL;
+      for (int i = first; i < first + sample_size; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        auto val = records[searchAlgorithm.search(keys_to_search_for[i])];
+        sample.record(std::chrono::nanoseconds(
+                          std::chrono::steady_clock::now() - t0)
+                          .count());
+        valSum += val;
+        assert(val == keys_to_search_for[i]);
+      }
+      p99[tid].push_back(sample.percentile(0.99));
+      latencies[tid].merge(sample);
+      return valSum;
+    });
+
+    std::vector<double> ns;
+    for (int t = 0; t < run.n_thds; t++) {
+      ns.insert(ns.end(), p99[t].begin(), p99[t].end());
+      if (t > 0)
+        latencies[0].merge(latencies[t]);
+    }
+    const auto &latency = latencies[0];
+    std::cerr << "Lookup latency ns: p50 " << latency.percentile(0.5)
+              << ", p99 " << latency.percentile(0.99) << ", p99.9 "
+              << latency.percentile(0.999) << ", max " << latency.max()
+              << '\n';
+    return ns;
+  }
+
+  static void reportCacheMisses(const TeamCacheMisses &misses,
+                                const double lookups) {
+    if (misses.available())
+      std::cerr << "LLC misses per lookup: " << misses.read() / lookups
+                << '\n';
+    else
+      std::cerr << "LLC misses per lookup: not available\n";
+  }
+
+  // Range partitioned execution with a shard per thread (Sharded). Each
+  // subset is a batch of sample_size queries per thread routed to the shards,
+  // the time per query is scaled by the number of threads to be comparable
+  // with searchAndMeasure: throughput is #threads / TimeNS in both.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> shardedAndMeasure(Run &run,
+                                               const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &queries = inputDataset.permuted_keys;
+    const long n_keys = queries.size(), batch = sample_size * run.n_thds;
+    const int n_samples = n_keys / sample_size;
+    assert(batch <= n_keys);
+
+    BuildMeter meter(run);
+    Sharded<SearchAlgorithm, record_bytes> index(inputDataset.keys,
+                                                 run.n_thds);
+    meter.done(index);
+
+    std::vector<double> ns(n_samples);
+    auto valSum = 0UL;
+    std::chrono::steady_clock::time_point t0;
+    TeamCacheMisses misses(run.n_thds);
+    ProfiledRegion profiled(run);
+#pragma omp parallel num_threads(run.n_thds) reduction(+ : valSum)
+    for (int sample_index = 0; sample_index < n_samples; sample_index++) {
+#pragma omp barrier
+#pragma omp master
+      t0 = std::chrono::steady_clock::now();
+      valSum += index.search_batch(queries.data(), n_keys,
+                                   sample_index * batch % n_keys, batch);
+#pragma omp barrier
+#pragma omp master
+      ns[sample_index] =
+          std::chrono::nanoseconds(std::chrono::steady_clock::now() - t0)
+              .count() *
+          run.n_thds / (double)batch;
+    }
+    run.ok = run.ok && valSum == inputDataset.sum * run.n_thds;
+    reportCacheMisses(misses, (double)n_samples * batch);
+    return ns;
+  }
+
+  // Searches a VersionedIndex while a builder thread rebuilds it from a copy
+  // of the records and publishes the new snapshot, over and over. Each lookup
+  // pins the current snapshot and is timed on its own, the percentiles of
+  // the lookup latency and the snapshots built are reported on stderr.
+  // Parameter: "rebuild" (default), or "static" to search without the
+  // builder, which leaves the cost of pinning and timing.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> versionedAndMeasure(Run &run,
+                                                 const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const int n_samples = keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+    const bool rebuild = !(run.params.size() > 0 && run.params[0] == "static");
+
+    BuildMeter meter(run);
+    VersionedIndex<SearchAlgorithm, record_bytes> index(keys.owned_copy(), run.n_thds);
+    meter.done(index);
+
+    std::atomic<bool> stop(false);
+    long builds = 0;
+    double build_ns = 0;
+    std::thread builder([&] {
+      while (rebuild && !stop.load(std::memory_order_relaxed)) {
+        auto t0 = std::chrono::steady_clock::now();
+        index.publish(keys.owned_copy());
+        build_ns += std::chrono::nanoseconds(
+                        std::chrono::steady_clock::now() - t0)
+                        .count();
+        builds++;
+      }
+    });
+
+    std::vector<LatencyHistogram> latencies(run.n_thds);
+    auto ns = measureSamples(run, n_samples, inputDataset.sum, [&](int first) {
+      const int reader = omp_get_thread_num();
+      LatencyHistogram &latency = latencies[reader];
+      auto valSum = 0UL;
+      for (int i = first; i < first + sample_size; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        Key val;
+        {
+          auto snapshot = index.pin(reader);
+          val = snapshot->searchAlgorithm.records()[
+              snapshot->searchAlgorithm.search(keys_to_search_for[i])];
+        }
+        latency.record(std::chrono::nanoseconds(
+                           std::chrono::steady_clock::now() - t0)
+                           .count());
+        valSum += val;
+        assert(val == keys_to_search_for[i]);
+      }
+      return valSum;
+    });
+    stop = true;
+    builder.join();
+    index.reclaim();
+
+    for (int t = 1; t < run.n_thds; t++)
+      latencies[0].merge(latencies[t]);
+    const auto &latency = latencies[0];
+    std::cerr << "Lookup latency ns: p50 " << latency.percentile(0.5)
+              << ", p99 " << latency.percentile(0.99) << ", p99.9 "
+              << latency.percentile(0.999) << ", max " << latency.max()
+              << '\n';
+    std::cerr << "Snapshots: " << builds << " published, "
+              << (builds > 0 ? build_ns / builds / 1e6 : 0.0)
+              << " ms per build, " << index.reclaimed() << " reclaimed, "
+              << index.pending() << " pending\n";
+    return ns;
+  }
+
+  // Searches queries of which a fraction are keys absent from the dataset,
+  // with the algorithm behind a BlockedBloom (Filtered). The same queries are
+  // first searched without the filter, the filter size, its false positive
+  // rate and the speedup are reported on stderr. Parameters: the fraction of
+  // absent keys (default 0.5), the bits per key of the filter (default 10).
+  // The checksum adds the keys found.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> filterAndMeasure(Run &run,
+                                              const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const int n_samples = keys.size() / sample_size;
+    const double miss_ratio =
+        run.params.size() > 0 ? parse<double>(run.params[0]) : 0.5;
+    const double bits_per_key =
+        run.params.size() > 1 ? parse<double>(run.params[1]) : 10;
+
+    // Absent keys are drawn between the smallest and the largest key, where
+    // every algorithm handles them. Dense datasets may have too few.
+    std::vector<Key> queries(inputDataset.permuted_keys.begin(),
+                             inputDataset.permuted_keys.begin() +
+                                 n_samples * sample_size);
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> coin(0, 1);
+    std::uniform_int_distribution<Key> between(keys[0], keys.back());
+    auto expected_sum = 0UL;
+    long misses = 0;
+    for (auto &q : queries) {
+      if (coin(rng) < miss_ratio)
+        for (int attempt = 0; attempt < 64; attempt++) {
+          Key x = between(rng);
+          if (!std::binary_search(keys.begin(), keys.end(), x,
+                                  [](Key a, Key b) { return a < b; })) {
+            q = x;
+            misses++;
+            break;
+          }
+        }
+      expected_sum += std::binary_search(keys.begin(), keys.end(), q,
+                                         [](Key a, Key b) { return a < b; })
+                          ? q
+                          : 0;
+    }
+
+    BuildMeter meter(run);
+    Filtered<SearchAlgorithm, record_bytes> index(keys, bits_per_key);
+    meter.done(index);
+    const auto &records = index.records();
+    const auto &filter = index.filter();
+
+    long false_positives = 0;
+    for (auto q : queries)
+      false_positives += filter.may_contain(q) && records[index.search(q)] != q;
+
+    auto search_sample = [&](auto &&search) {
+      return [&, search](int first) {
+        auto valSum = 0UL;
+        for (int i = first; i < first + sample_size; i++) {
+          auto val = records[search(queries[i])];
+          valSum += val == queries[i] ? val : 0;
+        }
+        return valSum;
+      };
+    };
+    auto unfiltered_ns = measureSamples(
+        run, n_samples, expected_sum, search_sample([&](Key x) {
+          return (Index)index.unfiltered().search(x);
+        }));
+    auto ns = measureSamples(
+        run, n_samples, expected_sum,
+        search_sample([&](Key x) { return index.search(x); }));
+
+    const double unfiltered = std::accumulate(unfiltered_ns.begin(),
+                                              unfiltered_ns.end(), 0.0) /
+                              unfiltered_ns.size(),
+                 filtered = std::accumulate(ns.begin(), ns.end(), 0.0) /
+                            ns.size();
+    std::cerr << "Filter: " << filter.bytes() * 8.0 / keys.size()
+              << " bits/key, " << filter.hashes() << " hashes, miss ratio "
+              << misses / (double)queries.size() << ", false positive rate "
+              << false_positives / (double)std::max(misses, 1L) << '\n';
+    std::cerr << "Unfiltered " << unfiltered << " ns, filtered " << filtered
+              << " ns, speedup " << unfiltered / filtered << '\n';
+    return ns;
+  }
+
+  template<typename SearchAlgorithm, int record_bytes, Touch touch>
+  static std::vector<double> searchTouchAndMeasure(
+      Run &run, const Dataset<record_bytes> &inputDataset, const int bytes) {
+    using Payload = PayloadTouch<record_bytes>;
+    const auto &keys = inputDataset.keys;
+    const int n_samples = keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+
+    BuildMeter meter(run);
+    SearchAlgorithm searchAlgorithm(keys);
+    meter.done(searchAlgorithm);
+    const auto &records = searchAlgorithm.records();
+
+    // Each thread copies the payloads of a subset to its own buffer.
+    const int out_bytes = std::max(Payload::payload_bytes, 1) * sample_size;
+    std::vector<char> out(out_bytes * run.n_thds);
+    auto expected_sum = 0UL;
+    for (int i = 0; i < n_samples * sample_size; i++) {
+      auto it = std::lower_bound(keys.begin(), keys.end(),
+                                 keys_to_search_for[i],
+                                 [](Key a, Key b) { return a < b; });
+      expected_sum += Payload::template apply<touch>(*it, bytes, out.data());
+    }
+
+    return measureSamples(run, n_samples, expected_sum, [&](int first) {
+      char *thread_out = &out[omp_get_thread_num() * out_bytes];
+      auto valSum = 0UL;
+      for (int i = first; i < first + sample_size; i++) {
+        const auto &record =
+            records.record(searchAlgorithm.search(keys_to_search_for[i]));
+        valSum += Payload::template apply<touch>(
+            record, bytes, thread_out + (i - first) * Payload::payload_bytes);
+      }
+      if (touch == Touch::CopyNT)
+        _mm_sfence();
+      return valSum;
+    });
+  }
+
+  // Finds each key and then uses its record. Parameters: "read,<bytes>" to
+  // read the first bytes of the payload, "checksum" to read all of it, "copy"
+  // or "copy-nt" to copy it to an output buffer, with non-temporal stores
+  // for copy-nt.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> searchPayloadAndMeasure(
+      Run &run, const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const std::string mode = run.params.size() > 0 ? run.params[0] : "read";
+    const int bytes = std::min<int>(
+        run.params.size() > 1 ? parse<int>(run.params[1]) : sizeof(Key),
+        PaddedVector<record_bytes>::payload_bytes);
+
+    if (mode == "read")
+      return searchTouchAndMeasure<SearchAlgorithm, record_bytes, Touch::Read>(
+          run, inputDataset, bytes);
+    if (mode == "checksum")
+      return searchTouchAndMeasure<SearchAlgorithm, record_bytes,
+                                   Touch::Checksum>(run, inputDataset, bytes);
+    if (mode == "copy")
+      return searchTouchAndMeasure<SearchAlgorithm, record_bytes, Touch::Copy>(
+          run, inputDataset, bytes);
+    if (mode == "copy-nt")
+      return searchTouchAndMeasure<SearchAlgorithm, record_bytes,
+                                   Touch::CopyNT>(run, inputDataset, bytes);
+    std::cerr << "payload mode " << mode << " not found.";
+    assert(!"Payload mode not found");
+    return std::vector<double>();
+  }
+
+  // Finds all the records matching each key with equal_range, the checksum
+  // is the number of records found.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> equalRangeAndMeasure(Run &run,
+                                                  const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const int n_samples = keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+
+    BuildMeter meter(run);
+    SearchAlgorithm searchAlgorithm(keys);
+    meter.done(searchAlgorithm);
+
+    auto expected_sum = 0UL;
+    for (int i = 0; i < n_samples * sample_size; i++) {
+      auto range = std::equal_range(keys.begin(), keys.end(),
+                                    keys_to_search_for[i],
+                                    [](Key a, Key b) { return a < b; });
+      expected_sum += range.second - range.first;
+    }
+    std::cerr << "Average matches per key: "
+              << expected_sum / (double)(n_samples * sample_size) << '\n';
+
+    return measureSamples(run, n_samples, expected_sum, [&](int first) {
+      auto valSum = 0UL;
+      for (int i = first; i < first + sample_size; i++)
+        valSum += searchAlgorithm.count(keys_to_search_for[i]);
+      return valSum;
+    });
+  }
+
+  // Range queries with RangeQuery: finds the first record of each range with
+  // the algorithm and scans the records with keys in [lo, hi). Parameters:
+  // the aggregate, "count" (default), "sum" of a payload field or "copy" of
+  // the records to a buffer; the records per range (default 100) or "all";
+  // the prefetch distance in bytes (default per record size, 0 for none).
+  // The ranges start at random records, there are fewer of them when they
+  // are wide to bound the records a thread scans. The checksum adds the
+  // counts, the sums, or the counts and the last keys copied.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> rangeScanAndMeasure(Run &run,
+                                                 const DatasetBase &dataset) {
+    using Scan = RangeScan<record_bytes>;
+    using Record = typename Scan::Record;
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const long n = keys.size();
+    const std::string mode = run.params.size() > 0 ? run.params[0] : "count";
+    long width = 100;
+    if (run.params.size() > 1)
+      width = run.params[1] == "all" ? n
+                                     : std::min(parse<long>(run.params[1]), n);
+    const int prefetch_bytes = run.params.size() > 2
+                                   ? parse<int>(run.params[2])
+                                   : Scan::default_prefetch_bytes;
+    if (mode != "count" && mode != "sum" && mode != "copy") {
+      std::cerr << "range scan mode " << mode << " not found.";
+      assert(!"Range scan mode not found");
+      return std::vector<double>();
+    }
+    const Aggregate agg = mode == "sum"    ? Aggregate::Sum
+                          : mode == "copy" ? Aggregate::Copy
+                                           : Aggregate::Count;
+
+    constexpr long max_scanned = 1L << 26;
+    const int n_samples = std::max(
+        1L, std::min(n / sample_size, max_scanned / (sample_size * width)));
+    auto position = [&](const Key x) {
+      return std::lower_bound(keys.begin(), keys.end(), x,
+                              [](Key a, Key b) { return a < b; }) -
+             keys.begin();
+    };
+    std::vector<unsigned long> prefix(n + 1);
+    for (long i = 0; i < n; i++)
+      prefix[i + 1] = prefix[i] + Scan::field(keys.record(i));
+
+    // a range of width records from a random one
+    std::vector<Key> los(n_samples * sample_size), his(los.size());
+    auto expected_sum = 0UL;
+    long scanned = 0, widest = 0;
+    for (size_t i = 0; i < los.size(); i++) {
+      const long r =
+          position(inputDataset.permuted_keys[i]) * (n - width + 1) / n;
+      los[i] = keys[r];
+      his[i] = r + width < n ? keys[r + width]
+                             : std::numeric_limits<Key>::max();
+      const long start = position(los[i]), end = position(his[i]);
+      scanned += end - start;
+      widest = std::max(widest, end - start);
+      if (agg == Aggregate::Sum)
+        expected_sum += prefix[end] - prefix[start];
+      else
+        expected_sum += end - start;
+      if (agg == Aggregate::Copy && end > start)
+        expected_sum += keys[end - 1];
+    }
+
+    BuildMeter meter(run);
+    SearchAlgorithm searchAlgorithm(keys);
+    meter.done(searchAlgorithm);
+    RangeQuery<SearchAlgorithm, record_bytes> ranges(searchAlgorithm,
+                                                     prefetch_bytes);
+    run.isa = isa_name(selected_isa());
+
+    std::vector<std::vector<Record>> out(run.n_thds);
+    if (agg == Aggregate::Copy)
+      for (auto &thread_out : out)
+        thread_out.resize(widest + Scan::slack);
+
+    auto ns = measureSamples(run, n_samples, expected_sum, [&](int first) {
+      Record *thread_out = out[omp_get_thread_num()].data();
+      auto valSum = 0UL;
+      for (int i = first; i < first + sample_size; i++) {
+        if (agg == Aggregate::Count) {
+          valSum += ranges.count(los[i], his[i]);
+        } else if (agg == Aggregate::Sum) {
+          valSum += ranges.sum(los[i], his[i]);
+        } else {
+          const Index copied = ranges.materialize(los[i], his[i], thread_out);
+          valSum += copied + (copied > 0 ? thread_out[copied - 1].k : 0);
+        }
+      }
+      return valSum;
+    });
+    const double records = scanned / (double)los.size();
+    std::cerr << "Ranges: " << los.size() << " of " << records
+              << " records on average, prefetch " << prefetch_bytes
+              << " bytes, "
+              << std::accumulate(ns.begin(), ns.end(), 0.0) / ns.size() /
+                     std::max(records, 1.0)
+              << " ns per record\n";
+    return ns;
+  }
+
+  // Searches a stream of keys where consecutive keys are close, each search
+  // starts from the result of the previous one with search_from.
+  // Parameters: the largest distance in records between consecutive keys
+  // (default 64), and "nohint" to search the same stream with search.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> fingerAndMeasure(Run &run,
+                                              const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const int n_samples = keys.size() / sample_size;
+    const long distance = run.params.size() > 0 ? parse<long>(run.params[0])
+                                                : 64;
+    const bool hint = !(run.params.size() > 1 && run.params[1] == "nohint");
+
+    // A random walk over the positions of the keys.
+    std::vector<Key> walk(n_samples * sample_size);
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<long> step(-distance, distance);
+    long pos = rng() % keys.size();
+    auto expected_sum = 0UL;
+    for (auto &k : walk) {
+      pos = std::min(std::max(pos + step(rng), 0L), (long)keys.size() - 1);
+      k = keys[pos];
+      expected_sum += k;
+    }
+
+    BuildMeter meter(run);
+    SearchAlgorithm searchAlgorithm(keys);
+    meter.done(searchAlgorithm);
+    const auto &records = searchAlgorithm.records();
+
+    return measureSamples(run, n_samples, expected_sum, [&](int first) {
+      auto valSum = 0UL;
+      Index ix = searchAlgorithm.search(walk[first]);
+      valSum += records[ix];
+      for (int i = first + 1; i < first + sample_size; i++) {
+        ix = hint ? searchAlgorithm.search_from(ix, walk[i])
+                  : searchAlgorithm.search(walk[i]);
+        valSum += records[ix];
+        assert(records[ix] == walk[i]);
+      }
+      return valSum;
+    });
+  }
+
+  // Searches sorted batches of keys with search_sorted_batch, the threads of
+  // the run share each batch. Parameter: the batch size (default 1000). The
+  // time of a batch is reported per key, the keys are sorted before timing.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> sortedBatchAndMeasure(Run &run,
+                                                   const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const long batch_size = std::min<long>(
+        run.params.size() > 0 ? parse<long>(run.params[0]) : sample_size,
+        keys.size());
+    const long n_batches = keys.size() / batch_size;
+    std::cerr << "Batch density: " << batch_size / (double)keys.size()
+              << " keys per record\n";
+
+    BuildMeter meter(run);
+    SearchAlgorithm searchAlgorithm(keys);
+    meter.done(searchAlgorithm);
+    const auto &records = searchAlgorithm.records();
+
+    std::vector<Key> batch(batch_size);
+    std::vector<Index> out(batch_size);
+    std::vector<double> ns;
+    // at least 10 batches, reusing the keys for large batches
+    for (long b = 0; b < std::max(n_batches, 10L); b++) {
+      auto first = inputDataset.permuted_keys.begin() +
+                   (b % n_batches) * batch_size;
+      std::copy(first, first + batch_size, batch.begin());
+      std::sort(batch.begin(), batch.end());
+
+      auto t0 = std::chrono::steady_clock::now();
+      search_sorted_batch(searchAlgorithm, batch.data(), batch_size,
+                          out.data(), run.n_thds);
+      auto t1 = std::chrono::steady_clock::now();
+      ns.push_back(std::chrono::nanoseconds(t1 - t0).count() /
+                   (double)batch_size);
+
+      for (long i = 0; i < batch_size; i++)
+        run.ok = run.ok && records[out[i]] == batch[i];
+    }
+    return ns;
+  }
+
+  // Binary Search with prefetching. Parameter: how many levels ahead to
+  // prefetch, 1 (default) to 3.
+  template<int record_bytes>
+  static std::vector<double> prefetchAndMeasure(Run &run,
+                                                const DatasetBase &dataset) {
+    switch (run.params.size() > 0 ? parse<int>(run.params[0]) : 1) {
+      case 1:
+        return searchAndMeasure<BinaryPrefetch<record_bytes, 1>, record_bytes>(
+            run, dataset);
+      case 2:
+        return searchAndMeasure<BinaryPrefetch<record_bytes, 2>, record_bytes>(
+            run, dataset);
+      case 3:
+        return searchAndMeasure<BinaryPrefetch<record_bytes, 3>, record_bytes>(
+            run, dataset);
+      default:assert(!"prefetch levels not supported");
+    }
+    return std::vector<double>();
+  }
+
+  // Searches each subset with one call to BinarySimd::search_batch.
+  // Parameter: the widest instruction set to use, "avx512", "avx2" or
+  // "scalar", by default the one of selected_isa().
+  template<int record_bytes>
+  static std::vector<double> simdAndMeasure(Run &run,
+                                            const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const int n_samples = inputDataset.keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+    const std::string isa =
+        run.params.size() > 0 ? run.params[0] : isa_name(selected_isa());
+
+    BuildMeter meter(run);
+    BinarySimd<record_bytes> searchAlgorithm(
+        inputDataset.keys, isa == "avx512" ? SimdWidth::AVX512
+                           : isa == "avx2" ? SimdWidth::AVX2
+                                           : SimdWidth::Scalar);
+    meter.done(searchAlgorithm);
+    const SimdWidth width = searchAlgorithm.simd_width();
+    std::cerr << "SIMD lanes: " << (int)width << '\n';
+    run.isa = isa_name(width == SimdWidth::AVX512 ? Isa::AVX512
+                       : width == SimdWidth::AVX2 ? Isa::AVX2
+                                                  : Isa::Base);
+    const auto &records = searchAlgorithm.records();
+    std::vector<Index> out(sample_size * run.n_thds);
+
+    return measureSamples(run, n_samples, inputDataset.sum, [&](int first) {
+      Index *thread_out = &out[omp_get_thread_num() * sample_size];
+      searchAlgorithm.search_batch(&keys_to_search_for[first], sample_size,
+                                   thread_out);
+      auto valSum = 0UL;
+      for (int i = 0; i < sample_size; i++) {
+        valSum += records[thread_out[i]];
+        assert(records[thread_out[i]] == keys_to_search_for[first + i]);
+      }
+      return valSum;
+    });
+  }
+
+#ifdef CORO_SEARCH
+  // Searches each subset with the coroutine version of the algorithm, with K
+  // lookups interleaved. Parameter: K (default 8). The same subsets are also
+  // searched with search(), stderr reports both means and their ratio, with
+  // K = 1 there is no interleaving and the ratio is the coroutine overhead.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> interleaveAndMeasure(Run &run,
+                                                  const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const int n_samples = inputDataset.keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+    const int k = run.params.size() > 0 ? parse<int>(run.params[0]) : 8;
+
+    BuildMeter meter(run);
+    SearchAlgorithm searchAlgorithm(inputDataset.keys);
+    meter.done(searchAlgorithm);
+    const auto &records = searchAlgorithm.records();
+    std::vector<Index> out(sample_size * run.n_thds);
+
+    auto search_sample = [&](auto &&search) {
+      return [&, search](int first) {
+        Index *thread_out = &out[omp_get_thread_num() * sample_size];
+        search(&keys_to_search_for[first], thread_out);
+        auto valSum = 0UL;
+        for (int i = 0; i < sample_size; i++) {
+          valSum += records[thread_out[i]];
+          assert(records[thread_out[i]] == keys_to_search_for[first + i]);
+        }
+        return valSum;
+      };
+    };
+    const auto plain_ns = measureSamples(
+        run, n_samples, inputDataset.sum,
+        search_sample([&](const Key *keys, Index *thread_out) {
+          for (int i = 0; i < sample_size; i++)
+            thread_out[i] = searchAlgorithm.search(keys[i]);
+        }));
+    auto ns = measureSamples(
+        run, n_samples, inputDataset.sum,
+        search_sample([&](const Key *keys, Index *thread_out) {
+          interleave(keys, sample_size, thread_out, k,
+                     [&](Key x) { return searchAlgorithm.search_coro(x); });
+        }));
+
+    const double plain = std::accumulate(plain_ns.begin(), plain_ns.end(),
+                                         0.0) / plain_ns.size(),
+                 coro = std::accumulate(ns.begin(), ns.end(), 0.0) / ns.size();
+    std::cerr << "search() " << plain << " ns, coroutines " << coro
+              << " ns with K = " << k << ", ratio " << coro / plain << '\n';
+    return ns;
+  }
+#endif
+
+  // Times the construction of the Eytzinger layout with run.n_thds threads,
+  // each value is the time of one construction in ns per key. Parameter:
+  // "parallel" (default), "recursive" for the sequential in-order traversal
+  // or "mmap" to build from the keys mapped from a binary key file.
+  template<int record_bytes>
+  static std::vector<double> eytBuildAndMeasure(Run &run,
+                                                const DatasetBase &dataset) {
+    using Eyt = b_eyt<record_bytes, true>;
+    using Vector = PaddedVector<record_bytes>;
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const std::string mode = run.params.size() > 0 ? run.params[0] : "parallel";
+    constexpr int n_builds = 10;
+
+    std::unique_ptr<MappedKeys> mapped;
+    if (mode == "mmap") {
+      char path[] = "/tmp/searchbench_keysXXXXXX";
+      int fd = mkstemp(path);
+      assert(fd >= 0);
+      close(fd);
+      MappedKeys::write(path, keys.begin(), keys.end());
+      mapped = std::make_unique<MappedKeys>(path);
+      unlink(path);
+    }
+    auto build = [&]() {
+      return mode == "recursive" ? Eyt::layout_recursive(keys)
+             : mode == "mmap"
+                 ? Eyt::layout(mapped->data(), mapped->size(), run.n_thds)
+                 : Eyt::layout(keys, run.n_thds);
+    };
+
+    std::vector<double> ns;
+    for (int b = 0; b < n_builds; b++) {
+      BuildMeter meter(run);
+      auto t0 = std::chrono::steady_clock::now();
+      Vector layout = build();
+      auto t1 = std::chrono::steady_clock::now();
+      meter.done(layout.bytes());
+      ns.push_back(std::chrono::nanoseconds(t1 - t0).count() /
+                   (double)keys.size());
+      if (b == 0) {
+        Vector expected = Eyt::layout_recursive(keys);
+        for (Index i = 0; i < (Index)keys.size(); i++)
+          run.ok = run.ok && std::memcmp(&layout.record(i), &expected.record(i),
+                                         sizeof(expected.record(i))) == 0;
+      }
+    }
+    std::cerr << "Eytzinger construction: "
+              << 1e3 / *std::min_element(ns.begin(), ns.end())
+              << " Mkeys/s\n";
+    return ns;
+  }
+
+  // Searches the keys of the dataset in a key file with one storage of
+  // paged_file.h per thread. Parameters: the storage, "direct" (default) for
+  // pread with O_DIRECT, "pread" or "mmap", then "cold" to drop the cached
+  // pages before each subset. Reports the pages touched and read per lookup.
+  template<template <class> class ExternalAlgorithm, int record_bytes>
+  static std::vector<double> externalAndMeasure(Run &run,
+                                                const DatasetBase &dataset) {
+    const std::string storage =
+        run.params.size() > 0 ? run.params[0] : "direct";
+    if (storage == "mmap")
+      return externalAndMeasure<ExternalAlgorithm<MmapPages>, MmapPages,
+                                record_bytes>(run, dataset, storage);
+    return externalAndMeasure<ExternalAlgorithm<PreadPages>, PreadPages,
+                              record_bytes>(run, dataset, storage);
+  }
+
+  template<typename SearchAlgorithm, typename Storage, int record_bytes>
+  static std::vector<double> externalAndMeasure(Run &run,
+                                                const DatasetBase &dataset,
+                                                const std::string &storage) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const int n_samples = keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+    const bool cold = run.params.size() > 1 && run.params[1] == "cold";
+
+    char path[] = "/tmp/searchbench_keysXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    MappedKeys::write(path, keys.begin(), keys.end());
+    std::vector<std::unique_ptr<Storage>> storages;
+    for (int t = 0; t < run.n_thds; t++) {
+      if constexpr (std::is_same_v<Storage, MmapPages>)
+        storages.push_back(std::make_unique<MmapPages>(path));
+      else
+        storages.push_back(
+            std::make_unique<PreadPages>(path, storage == "direct"));
+    }
+    unlink(path);
+
+    BuildMeter meter(run);
+    SearchAlgorithm searchAlgorithm(*storages[0]);
+    meter.done(searchAlgorithm);
+    for (auto &s : storages)
+      s->evict();
+    const uint64_t touches0 = storages[0]->touches, reads0 = storages[0]->reads;
+
+    auto ns = measureSamples(
+        run, n_samples, inputDataset.sum,
+        [&](int) {
+          if (cold)
+            storages[omp_get_thread_num()]->evict();
+        },
+        [&](int first) {
+          Storage &s = *storages[omp_get_thread_num()];
+          auto valSum = 0UL;
+          for (int i = first; i < first + sample_size; i++) {
+            auto val = keys[searchAlgorithm.search(s, keys_to_search_for[i])];
+            valSum += val;
+            assert(val == keys_to_search_for[i]);
+          }
+          return valSum;
+        });
+
+    uint64_t touches = -touches0, reads = -reads0;
+    for (auto &s : storages) {
+      touches += s->touches;
+      reads += s->reads;
+    }
+    const double lookups = (double)n_samples * sample_size * run.n_thds;
+    std::cerr << "Pages per lookup: " << touches / lookups << " touched, "
+              << reads / lookups << " read\n";
+    return ns;
+  }
+
+  // Searches the variable-length keys of a str-* dataset (StringDataset),
+  // the checksum adds the offsets of the keys found. Reports the shape of the
+  // keys that decides whether interpolating on their prefixes pays off.
+  template<typename SearchAlgorithm>
+  static std::vector<double> stringAndMeasure(Run &run,
+                                              const DatasetBase &dataset) {
+    const auto &inputDataset = static_cast<const StringDataset &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const int n_samples = keys.size() / sample_size;
+    auto &keys_to_search_for = inputDataset.permuted_keys;
+
+    long ties = 0;
+    for (Index i = 1; i < (Index)keys.size(); i++)
+      ties += keys.record(i).prefix == keys.record(i - 1).prefix;
+    std::cerr << "String keys: " << keys.size() << " keys of "
+              << keys.bytes_of_keys() / (double)keys.size()
+              << " bytes on average, common prefix of "
+              << keys.common_prefix().size() << " bytes, "
+              << 100.0 * ties / keys.size()
+              << "% tie on the prefix with the previous key\n";
+
+    BuildMeter meter(run);
+    SearchAlgorithm searchAlgorithm(keys);
+    meter.done(searchAlgorithm);
+    const auto &records = searchAlgorithm.records();
+
+    return measureSamples(run, n_samples, inputDataset.sum, [&](int first) {
+      auto valSum = 0UL;
+      for (int i = first; i < first + sample_size; i++) {
+        const auto &record =
+            records.record(searchAlgorithm.search(keys_to_search_for[i]));
+        valSum += record.offset;
+        assert(records.key(record) == keys_to_search_for[i]);
+      }
+      return valSum;
+    });
+  }
+
+  // Searches many small independent partitions of the dataset held by one
+  // PartitionedIndex. Each query is a (partition id, key) pair.
+  // Parameters: partition size in keys (default 1000), and "grouped" to
+  // order the queries of each subset by partition.
+  template<typename Meta, int record_bytes>
+  static std::vector<double> searchPartitionsAndMeasure(
+      Run &run, const DatasetBase &dataset) {
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+    const auto &keys = inputDataset.keys;
+    const int n_samples = keys.size() / sample_size;
+    const Index partition_size =
+        run.params.size() > 0 ? parse<Index>(run.params[0]) : 1000;
+    const bool grouped = run.params.size() > 1 && run.params[1] == "grouped";
+    assert(partition_size >= 1);
+
+    std::vector<Index> bounds;
+    for (Index b = 0; b < (Index)keys.size(); b += partition_size)
+      bounds.push_back(b);
+    bounds.push_back(keys.size());
+
+    using Partitioned = PartitionedIndex<record_bytes, Meta>;
+    BuildMeter meter(run);
+    Partitioned index(keys, bounds);
+    meter.done(index);
+
+    std::vector<typename Partitioned::Query> queries;
+    queries.reserve(inputDataset.permuted_keys.size());
     for (auto k : inputDataset.permuted_keys) {
-      auto val = searchAlgorithm.search_metadata(k);
-      iterations += val.first;
-      steps += val.second;
+      Index pos = std::lower_bound(keys.begin(), keys.end(), k,
+                                   [](Key a, Key b) { return a < b; }) -
+                  keys.begin();
+      queries.push_back({pos / partition_size, k});
     }
+    if (grouped)
+      for (auto it = queries.begin();
+           it + sample_size <= queries.end(); it += sample_size)
+        std::stable_sort(it, it + sample_size, [](auto &a, auto &b) {
+          return a.partition < b.partition;
+        });
+
+    std::cerr << "Partitions: " << index.partitions() << " x "
+              << partition_size << " keys, construction "
+              << run.build_ns / index.partitions()
+              << " ns/array, metadata " << index.metadata_bytes()
+              << " bytes/array\n";
 
-    std::cout<< (double) iterations / (double)inputDataset.permuted_keys.size()
-    << " " << (double)steps / (double)inputDataset.permuted_keys.size()
-    << std::endl;
+    return measureSamples(run, n_samples, inputDataset.sum, [&](int first) {
+      auto valSum = 0UL;
+      for (int i = first; i < first + sample_size; i++) {
+        auto val =
+            index.records()[index.search(queries[i].partition, queries[i].key)];
+        valSum += val;
+        assert(val == queries[i].key);
+      }
+      return valSum;
+    });
+  }
+
+  // Counts the work of each lookup with the algorithm instrumented with
+  // LookupStats (lookup_stats.h) and times it with the plain algorithm, one
+  // lookup at a time on one thread. Reports on stderr the histograms of the
+  // interpolation and bisection probes, the guards, the steps of the linear
+  // search and the distinct cache lines read per lookup, with the mean
+  // latency of the lookups of each bucket. Prints on stdout the mean
+  // iterations of the search loop (probes and guards) and linear search
+  // steps, as sip_metadata always did, and no timed subsets.
+  template<typename SearchAlgorithm, int record_bytes>
+  static std::vector<double> searchAndMetadata(Run &run,
+                                              const DatasetBase &dataset) {
+    using Instrumented =
+        typename SearchAlgorithm::template with_stats<LookupStats>;
+    const auto
+        &inputDataset = static_cast<const Dataset<record_bytes> &>(dataset);
+
+    SearchAlgorithm searchAlgorithm(inputDataset.keys);
+    Instrumented instrumented(inputDataset.keys);
+    const auto &records = searchAlgorithm.records();
+    auto &stats = instrumented.stats();
+
+    WorkHistogram interpolations, bisections, guards, steps, lines;
+    for (auto k : inputDataset.permuted_keys) {
+      auto t0 = std::chrono::steady_clock::now();
+      auto val = records[searchAlgorithm.search(k)];
+      const double ns =
+          std::chrono::nanoseconds(std::chrono::steady_clock::now() - t0)
+              .count();
+      stats.reset();
+      run.ok = run.ok && val == k &&
+               instrumented.records()[instrumented.search(k)] == k;
+      interpolations.record(stats.interpolations, ns);
+      bisections.record(stats.bisections, ns);
+      guards.record(stats.guards, ns);
+      steps.record(stats.linear_steps, ns);
+      lines.record(stats.lines(), ns);
+    }
+
+    std::cout << interpolations.mean() + bisections.mean() + guards.mean()
+              << " " << steps.mean() << std::endl;
+    std::cerr << "Per lookup, fraction of the lookups and their latency\n";
+    interpolations.print(std::cerr, "Interpolation probes");
+    bisections.print(std::cerr, "Bisection probes");
+    guards.print(std::cerr, "Guard hits");
+    steps.print(std::cerr, "Linear search steps");
+    lines.print(std::cerr, "Cache lines read");
     return {};
   }
 
   template<int record_bytes>
   static std::vector<double>
               findAlgorithmAndSearch(Run &run, const DatasetBase &dataset) {
-    constexpr auto algorithm_mapper = std::array < fn_tuple,
-    8 > {
+    constexpr auto algorithm_mapper = std::array{
         // Interpolation Search
         make_tuple("is",
                    searchAndMeasure<InterpolationSearch<record_bytes>,
@@ -149,21 +1439,192 @@ struct Run {
         make_tuple("sip", searchAndMeasure<sip<record_bytes>, record_bytes>),
         make_tuple("tip",
                    searchAndMeasure<tip<record_bytes, 64>, record_bytes>),
+        // Interpolation Search bisecting when an interpolation fails
+        make_tuple("ibs",
+                   searchAndMeasure<InterpolationBinary<record_bytes>,
+                                    record_bytes>),
         // Binary Search
         make_tuple("bs", searchAndMeasure<Binary<record_bytes>, record_bytes>),
+        // Binary Search prefetching the next midpoints
+        make_tuple("bs-p", prefetchAndMeasure<record_bytes>),
         // Search Eytzinger
         make_tuple("b-eyt", searchAndMeasure<b_eyt<record_bytes, false>, record_bytes>),
         // Search Eytzinger with prefetch
         make_tuple("b-eyt-p",
                    searchAndMeasure<b_eyt<record_bytes, true>, record_bytes>),
-        // Collects numer of intepolation and sequential steps of SIP
+        // Range partitioned, a shard per thread
+        make_tuple("sharded-sip",
+                   shardedAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("sharded-bs",
+                   shardedAndMeasure<Binary<record_bytes>, record_bytes>),
+        make_tuple("sharded-b-eyt-p",
+                   shardedAndMeasure<b_eyt<record_bytes, true>, record_bytes>),
+        // Searched while a builder thread replaces the index
+        make_tuple("versioned-sip",
+                   versionedAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("versioned-bs",
+                   versionedAndMeasure<Binary<record_bytes>, record_bytes>),
+        make_tuple("versioned-b-eyt-p",
+                   versionedAndMeasure<b_eyt<record_bytes, true>,
+                                       record_bytes>),
+        // Bloom filter in front of the search, for absent keys
+        make_tuple("filter-sip",
+                   filterAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("filter-bs",
+                   filterAndMeasure<Binary<record_bytes>, record_bytes>),
+        make_tuple("filter-b-eyt-p",
+                   filterAndMeasure<b_eyt<record_bytes, true>, record_bytes>),
+        // Search of a key file, see the storage parameter
+        make_tuple("ext-bs", externalAndMeasure<ExternalBinary, record_bytes>),
+        make_tuple("ext-is",
+                   externalAndMeasure<ExternalInterpolation, record_bytes>),
+        make_tuple("ext-fence",
+                   externalAndMeasure<ExternalFence, record_bytes>),
+        // Construction of the Eytzinger layout
+        make_tuple("b-eyt-build", eytBuildAndMeasure<record_bytes>),
+        // Counts the records matching each key, see the dup dataset
+        make_tuple("is-range",
+                   equalRangeAndMeasure<InterpolationSearch<record_bytes>,
+                                        record_bytes>),
+        make_tuple("sip-range",
+                   equalRangeAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("tip-range",
+                   equalRangeAndMeasure<tip<record_bytes, 64>, record_bytes>),
+        make_tuple("bs-range",
+                   equalRangeAndMeasure<Binary<record_bytes>, record_bytes>),
+        make_tuple("bs-p-range",
+                   equalRangeAndMeasure<BinaryPrefetch<record_bytes>,
+                                        record_bytes>),
+        make_tuple("b-eyt-range",
+                   equalRangeAndMeasure<b_eyt<record_bytes, true>,
+                                        record_bytes>),
+        // Range queries, found with the algorithm and scanned
+        make_tuple("is-scan",
+                   rangeScanAndMeasure<InterpolationSearch<record_bytes>,
+                                       record_bytes>),
+        make_tuple("sip-scan",
+                   rangeScanAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("tip-scan",
+                   rangeScanAndMeasure<tip<record_bytes, 64>, record_bytes>),
+        make_tuple("ibs-scan",
+                   rangeScanAndMeasure<InterpolationBinary<record_bytes>,
+                                       record_bytes>),
+        make_tuple("bs-scan",
+                   rangeScanAndMeasure<Binary<record_bytes>, record_bytes>),
+        // Search and then read or copy the payload of the record
+        make_tuple("is-payload",
+                   searchPayloadAndMeasure<InterpolationSearch<record_bytes>,
+                                           record_bytes>),
+        make_tuple("sip-payload",
+                   searchPayloadAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("tip-payload",
+                   searchPayloadAndMeasure<tip<record_bytes, 64>,
+                                           record_bytes>),
+        make_tuple("bs-payload",
+                   searchPayloadAndMeasure<Binary<record_bytes>, record_bytes>),
+        make_tuple("b-eyt-p-payload",
+                   searchPayloadAndMeasure<b_eyt<record_bytes, true>,
+                                           record_bytes>),
+        // Loaded from an index file instead of built
+        make_tuple("load-is",
+                   loadAndMeasure<InterpolationSearch<record_bytes>,
+                                  record_bytes>),
+        make_tuple("load-sip", loadAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("load-tip",
+                   loadAndMeasure<tip<record_bytes, 64>, record_bytes>),
+        make_tuple("load-bs",
+                   loadAndMeasure<Binary<record_bytes>, record_bytes>),
+        make_tuple("load-bs-p",
+                   loadAndMeasure<BinaryPrefetch<record_bytes>, record_bytes>),
+        make_tuple("load-b-eyt-p",
+                   loadAndMeasure<b_eyt<record_bytes, true>, record_bytes>),
+        make_tuple("load-ibs",
+                   loadAndMeasure<InterpolationBinary<record_bytes>,
+                                  record_bytes>),
+        // The p99 latency of single lookups
+        make_tuple("is-tail",
+                   tailAndMeasure<InterpolationSearch<record_bytes>,
+                                  record_bytes>),
+        make_tuple("sip-tail", tailAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("tip-tail",
+                   tailAndMeasure<tip<record_bytes, 64>, record_bytes>),
+        make_tuple("bs-tail",
+                   tailAndMeasure<Binary<record_bytes>, record_bytes>),
+        make_tuple("ibs-tail",
+                   tailAndMeasure<InterpolationBinary<record_bytes>,
+                                  record_bytes>),
+        // Streams of nearby keys searched from the previous result
+        make_tuple("is-finger",
+                   fingerAndMeasure<InterpolationSearch<record_bytes>,
+                                    record_bytes>),
+        make_tuple("sip-finger",
+                   fingerAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("tip-finger",
+                   fingerAndMeasure<tip<record_bytes, 64>, record_bytes>),
+        make_tuple("bs-finger",
+                   fingerAndMeasure<Binary<record_bytes>, record_bytes>),
+        make_tuple("bs-p-finger",
+                   fingerAndMeasure<BinaryPrefetch<record_bytes>,
+                                    record_bytes>),
+        make_tuple("b-eyt-p-finger",
+                   fingerAndMeasure<b_eyt<record_bytes, true>, record_bytes>),
+        // Sorted batches of keys searched together
+        make_tuple("sip-batch",
+                   sortedBatchAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("bs-batch",
+                   sortedBatchAndMeasure<Binary<record_bytes>, record_bytes>),
+        make_tuple("b-eyt-p-batch",
+                   sortedBatchAndMeasure<b_eyt<record_bytes, true>,
+                                         record_bytes>),
+        // Binary Search of several keys in SIMD lanes
+        make_tuple("bs-simd", simdAndMeasure<record_bytes>),
+#ifdef CORO_SEARCH
+        // Coroutines with interleaved lookups
+        make_tuple("sip-coro",
+                   interleaveAndMeasure<sip<record_bytes>, record_bytes>),
+        make_tuple("tip-coro",
+                   interleaveAndMeasure<tip<record_bytes, 64>, record_bytes>),
+        make_tuple("bs-coro",
+                   interleaveAndMeasure<Binary<record_bytes>, record_bytes>),
+#endif
+        // Many small partitions searched through one PartitionedIndex
+        make_tuple("parts-sip",
+                   searchPartitionsAndMeasure<PartitionSip, record_bytes>),
+        make_tuple("parts-bs",
+                   searchPartitionsAndMeasure<PartitionBinary, record_bytes>),
+        make_tuple("parts-isseq",
+                   searchPartitionsAndMeasure<PartitionIsSeq, record_bytes>),
+        // Variable-length keys of the str-* datasets
+        make_tuple("str-bs", stringAndMeasure<StringBinary>),
+        make_tuple("str-sip", stringAndMeasure<StringSip<>>),
+        make_tuple("str-b-eyt-p", stringAndMeasure<StringEyt<true>>),
+        // Counts the probes, guards, linear search steps and cache lines
+        // of each lookup, see LookupStats
         make_tuple("sip_metadata",
                    searchAndMetadata<sip<record_bytes>, record_bytes>),
+        make_tuple("is_metadata",
+                   searchAndMetadata<InterpolationSearch<record_bytes>,
+                                     record_bytes>),
+        make_tuple("tip_metadata",
+                   searchAndMetadata<tip<record_bytes, 64>, record_bytes>),
+        make_tuple("ibs_metadata",
+                   searchAndMetadata<InterpolationBinary<record_bytes>,
+                                     record_bytes>),
+        make_tuple("bs_metadata",
+                   searchAndMetadata<Binary<record_bytes>, record_bytes>),
+        make_tuple("bs-p_metadata",
+                   searchAndMetadata<BinaryPrefetch<record_bytes>,
+                                     record_bytes>),
+        make_tuple("bs-simd_metadata",
+                   searchAndMetadata<BinarySimd<record_bytes>, record_bytes>),
+        make_tuple("b-eyt-p_metadata",
+                   searchAndMetadata<b_eyt<record_bytes, true>,
+                                     record_bytes>),
     };
     // Find the correct search algorithm to use as specified in the run.
     auto it = std::find_if(
         algorithm_mapper.begin(), algorithm_mapper.end(), [run](const auto &x) {
-          return std::string(std::get<const char *>(x)) == run.name;
+          return std::string(std::get<const char *>(x)) == run.algorithm;
         });
 
     if (it == algorithm_mapper.end()) {
@@ -183,6 +1644,14 @@ struct Run {
     // Stores the times to search each 1000 record subset
     std::vector<double> ns;
 
+    // The str-* algorithms search the str-* datasets and only them
+    if (is_string_distribution(distribution) !=
+        (algorithm.rfind("str-", 0) == 0)) {
+      std::cerr << name << " does not search " << distribution << " datasets\n";
+      ok = false;
+      return ns;
+    }
+
     // Find the correct alorithm and run it
     switch (dataset_param.record_bytes) {
       case 8:ns = findAlgorithmAndSearch<8>(*this, dataset);
@@ -3,6 +3,7 @@
 
 #include "benchmark.h"
 #include "datasets.h"
+#include "memory_usage.h"
 
 #include <algorithm>
 #include <chrono>
@@ -66,9 +67,12 @@ auto reverseRunFileIndex(std::vector<std::string> v) {
   return m;
 }
 
+// The optional Queries column holds the trace of probe keys of the run,
+// see query_source.h, or "-" for the keys of the dataset.
 auto loadRunsFromFile(std::ifstream &&file) {
   auto header = reverseRunFileIndex(split(read_line(file), '\t'));
-  assert(header.size() == 6);
+  const bool has_queries = header.count("Queries") == 1;
+  assert(header.size() == 6 + has_queries);
   std::vector<Run> runs;
   for (; file.good();) {
     auto fields = split(read_line(file), '\t');
@@ -80,8 +84,11 @@ auto loadRunsFromFile(std::ifstream &&file) {
         .n = parse2<long>(fields[header["DatasetSize"]]),
         .record_bytes =
         parse2<int>(fields[header["RecordSizeBytes"]])};
+    std::string queries =
+        has_queries ? fields[header["Queries"]] : std::string("-");
     runs.emplace_back(dataset_param, fields[header["SearchAlgorithm"]],
-                      parse2<int>(fields[header["#threads"]]));
+                      parse2<int>(fields[header["#threads"]]),
+                      queries == "-" ? "" : queries);
   }
   return runs;
 }
@@ -96,24 +103,37 @@ static void createDataset(DatasetParam dataset_param,
 
     auto dataset_params = split(dataset_param.param);
     input_map.emplace((DatasetParam::Tuple)dataset_param, [=]() {
+      if (is_string_distribution(dataset_param.distribution))
+        return static_cast<std::unique_ptr<DatasetBase>>(
+            std::make_unique<StringDataset>(
+                dataset_param.n, dataset_param.distribution, dataset_params));
+      // the datasets of one distribution at several record sizes share their
+      // keys and query permutation, generated once
+      static std::map<KeySet::Id, std::weak_ptr<const KeySet>> key_sets;
+      auto &cached = key_sets[{dataset_param.distribution, dataset_param.param,
+                               dataset_param.n}];
+      auto key_set = cached.lock();
+      if (!key_set) {
+        key_set = std::make_shared<const KeySet>(
+            dataset_param.n, dataset_param.distribution, dataset_params);
+        cached = key_set;
+      }
       switch (dataset_param.record_bytes) {
         case 8:
           return static_cast<std::unique_ptr<DatasetBase>>(
-              std::make_unique<Dataset<8>>(
-                  dataset_param.n, dataset_param.distribution, dataset_params));
+              std::make_unique<Dataset<8>>(key_set));
         case 32:
           return static_cast<std::unique_ptr<DatasetBase>>(
-              std::make_unique<Dataset<32>>(
-                  dataset_param.n, dataset_param.distribution, dataset_params));
+              std::make_unique<Dataset<32>>(key_set));
         case 128:
           return static_cast<std::unique_ptr<DatasetBase>>(
-              std::make_unique<Dataset<128>>(
-                  dataset_param.n, dataset_param.distribution, dataset_params));
+              std::make_unique<Dataset<128>>(key_set));
         default:
           assert(!"record size not supported");
       };
       return std::make_unique<DatasetBase>();
     }());
+    std::cerr << "Peak RSS: " << peak_rss_kb() / 1024 << " MiB" << '\n';
   }
   std::cerr << std::endl;
 }
@@ -3,6 +3,7 @@
 
 #include "util.h"
 #include "padded_vector.h"
+#include "string_keys.h"
 
 #include <algorithm>
 #include <chrono>
@@ -17,6 +18,7 @@
 #include <sstream>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <memory>
 
@@ -42,79 +44,72 @@ struct DatasetParam {
 struct DatasetBase {
   using DatasetMap =
                 std::map<DatasetParam::Tuple, std::unique_ptr<DatasetBase>>;
-};
 
+  virtual ~DatasetBase() = default;
+};
 
-// Parse and create the datasets, generate the keys or import from a file.
-template <int record_bytes> struct Dataset : public DatasetBase {
+// The keys of a dataset and the queries searched in it, which do not depend
+// on the record size: generated once and shared by the Datasets of every
+// record size. The sorted keys are generated in place, in the padded storage
+// of 8 byte records that Dataset<8> searches without a copy.
+struct KeySet {
  private:
-  auto uniform(long seed) {
+  // The generators write the n sorted keys to v.
+  static void uniform(Key *v, const size_t n, long seed) {
     std::mt19937_64 rng(seed);
     std::uniform_int_distribution<Key> dist(1, (1ULL << 63) - 2);
-    std::vector<Key> v(keys.size());
-    for (auto &y : v)
-      y = dist(rng);
-    std::sort(v.begin(), v.end());
-    return v;
+    for (size_t i = 0; i < n; i++)
+      v[i] = dist(rng);
+    std::sort(v, v + n);
   }
 
-  auto gap(long seed, double sparsity) {
+  static void gap(Key *v, const size_t n, long seed, double sparsity) {
     assert(sparsity <= 1.0);
 
-    std::vector<Key> v(keys.size());
-    long range = v.size() / sparsity;
-    assert(range >= v.size());
+    long range = n / sparsity;
+    assert(range >= n);
 
     std::mt19937_64 rng(seed);
     std::uniform_int_distribution<Key> dist(1, range + 1);
     std::set<Key> skips;
-    while (skips.size() + v.size() < range)
+    while (skips.size() + n < range)
       skips.insert(dist(rng));
     for (Key k = 1, i = 0; k < range + 1; k++)
       if (skips.count(k) == 0)
         v[i++] = k;
-    return v;
   }
 
-  auto fal(double shape) {
-    std::vector<Key> v(keys.size());
-    auto n = v.size();
-    for (auto i = 0; i < v.size() - 1; i++) {
+  static void fal(Key *v, const size_t n, double shape) {
+    for (auto i = 0; i < n - 1; i++) {
       // scale up to ensure elements are distinct for as long as possible
       v[i] = pow((double)(n - i), -shape) * std::numeric_limits<Key>::max();
     }
-    v.back() = std::numeric_limits<Key>::max();
-    return v;
+    v[n - 1] = std::numeric_limits<Key>::max();
   }
 
-  auto cfal(double shape) {
-    auto v = fal(shape);
-    auto max_sum = std::accumulate(v.begin(), v.end(), 0.0L);
+  static void cfal(Key *v, const size_t n, double shape) {
+    fal(v, n, shape);
+    auto max_sum = std::accumulate(v, v + n, 0.0L);
     auto scale = std::numeric_limits<Key>::max() / max_sum;
-    std::transform(v.begin(), v.end(), v.begin(),
-                   [scale](auto x) { return x * scale; });
-    std::partial_sum(v.begin(), v.end(), v.begin());
-    return v;
+    std::transform(v, v + n, v, [scale](auto x) { return x * scale; });
+    std::partial_sum(v, v + n, v);
   }
 
-  void fill(const std::vector<Key> &&v, long seed = 42) {
-    keys = std::move(v);
-    permuted_keys.resize(keys.size());
-    std::copy(keys.begin(), keys.end(), permuted_keys.begin());
-    std::shuffle(permuted_keys.begin(), permuted_keys.end(),
-                 std::mt19937(seed));
+  // Uniform random keys, each repeated run_length times.
+  static void dup(Key *v, const size_t n, long seed, long run_length) {
+    assert(run_length >= 1);
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<Key> dist(1, (1ULL << 63) - 2);
+    std::vector<Key> distinct((n + run_length - 1) / run_length);
+    for (auto &y : distinct)
+      y = dist(rng);
+    std::sort(distinct.begin(), distinct.end());
+    for (size_t i = 0; i < n; i++)
+      v[i] = distinct[i / run_length];
   }
 
- public:
-  using Id = std::tuple<long, std::string, std::string>;
-
-  std::vector<Key> permuted_keys;
-  PaddedVector<record_bytes> keys;
-  unsigned long sum;
-
-  Dataset(const long n, const std::string &distribution,
-        const std::vector<std::string> &params)
-      : permuted_keys(n), keys(n) {
+  static PaddedVector<8> generate(const long n, const std::string &distribution,
+                                  const std::vector<std::string> &params) {
     auto param = params.begin();
     // datasetname - parameter
     // uniform     - random gen seed
@@ -122,29 +117,194 @@ template <int record_bytes> struct Dataset : public DatasetBase {
     // file        - path
     // fal         - shape
     // cfal        - shape
+    // dup         - random gen seed,run length
+    if (std::set<std::string>{"file", "fb", "wf", "lognormal"}.count(
+        distribution) == 1) {
+      // as many keys as the file holds
+      std::ifstream file{param[0]};
+      return PaddedVector<8>(std::vector<Key>{std::istream_iterator<Key>{file},
+                                              std::istream_iterator<Key>()});
+    }
+    PaddedVector<8> keys(n);
+    Key *v = &keys[0];
     if (distribution == "uniform") {
       auto seed = parse<long>(param[0]);
-      fill(uniform(seed));
+      uniform(v, n, seed);
     } else if (distribution == "gap") {
       auto seed = parse<long>(param[0]);
       auto sparsity = parse<double>(param[1]);
-      fill(gap(seed, sparsity));
+      gap(v, n, seed, sparsity);
+    } else if (distribution == "dup") {
+      auto seed = parse<long>(param[0]);
+      auto run_length = parse<long>(param[1]);
+      dup(v, n, seed, run_length);
     } else if (distribution == "fal") {
       auto shape = parse<double>(param[0]);
-      fill(fal(shape));
+      fal(v, n, shape);
     } else if (distribution == "cfal") {
       auto shape = parse<double>(param[0]);
-      fill(cfal(shape));
-    } else if (std::set<std::string>{"file", "fb", "wf", "lognormal"}.count(
-        distribution) == 1) {
-      std::ifstream file{param[0]};
-      fill(std::vector<Key>{std::istream_iterator<Key>{file},
-                            std::istream_iterator<Key>()});
+      cfal(v, n, shape);
     } else {
       assert(!"No distribution found.");
     }
+    return keys;
+  }
+
+ public:
+  using Id = std::tuple<std::string, std::string, long>;
+
+  PaddedVector<8> keys;
+  std::vector<Key> permuted_keys;
+  unsigned long sum;
+
+  KeySet(const long n, const std::string &distribution,
+         const std::vector<std::string> &params, long seed = 42)
+      : keys(generate(n, distribution, params)),
+        permuted_keys(keys.begin(), keys.end()),
+        sum(std::accumulate(keys.begin(), keys.end(), 0UL)) {
+    std::shuffle(permuted_keys.begin(), permuted_keys.end(),
+                 std::mt19937(seed));
+  }
+
+  KeySet(const KeySet &) = delete;
+  KeySet &operator=(const KeySet &) = delete;
+};
+
+// The records of a dataset, of the keys of a KeySet.
+template <int record_bytes> struct Dataset : public DatasetBase {
+ private:
+  using Vector = PaddedVector<record_bytes>;
+
+  // A view of the keys of the KeySet for 8 byte records, otherwise the
+  // records are written straight to their padded storage.
+  static Vector records(const KeySet &key_set) {
+    if constexpr (record_bytes == 8) {
+      return Vector::view(
+          const_cast<typename Vector::Record *>(key_set.keys.padded_data()),
+          key_set.keys.size());
+    } else {
+      Vector v(key_set.keys.size());
+      for (Index i = 0; i < (Index)v.size(); i++)
+        v.record(i) = typename Vector::Record(key_set.keys[i]);
+      return v;
+    }
+  }
+
+ public:
+  using Id = std::tuple<long, std::string, std::string>;
+
+  const std::shared_ptr<const KeySet> key_set;
+  const std::vector<Key> &permuted_keys;
+  PaddedVector<record_bytes> keys;
+  unsigned long sum;
+
+  Dataset(std::shared_ptr<const KeySet> key_set)
+      : key_set(key_set), permuted_keys(key_set->permuted_keys),
+        keys(records(*key_set)), sum(key_set->sum) {}
+
+  Dataset(const long n, const std::string &distribution,
+          const std::vector<std::string> &params)
+      : Dataset(std::make_shared<const KeySet>(n, distribution, params)) {}
+};
+
+// The distributions of variable-length keys start with "str-".
+inline bool is_string_distribution(const std::string &distribution) {
+  return distribution.rfind("str-", 0) == 0;
+}
+
+// A dataset of variable-length keys, see string_keys.h. The record size of
+// the experiment does not apply, the records are the 16 bytes of
+// StringKeys::Record.
+struct StringDataset : public DatasetBase {
+ private:
+  // URL-like keys: a scheme, one of a few hundred hosts, most of them
+  // under "www.", and a path of words and a number.
+  static std::vector<std::string> urls(const long n, const long seed) {
+    std::mt19937_64 rng(seed);
+    auto word = [&](const int min_len, const int max_len) {
+      std::string w(min_len + rng() % (max_len - min_len + 1), 'a');
+      for (auto &c : w)
+        c = 'a' + rng() % 26;
+      return w;
+    };
+    std::vector<std::string> hosts(256);
+    for (auto &h : hosts)
+      h = (rng() % 4 ? "www." : word(2, 4) + ".") + word(3, 12) +
+          (rng() % 2 ? ".com" : ".org");
+    std::vector<std::string> sections(32);
+    for (auto &s : sections)
+      s = word(3, 10);
 
-    sum = std::accumulate(keys.begin(), keys.end(), 0UL);
+    std::unordered_set<std::string> keys;
+    while ((long)keys.size() < n)
+      keys.insert("https://" + hosts[rng() % hosts.size()] + "/" +
+                  sections[rng() % sections.size()] + "/" + word(4, 16) + "-" +
+                  std::to_string(rng() % 1000000));
+    return std::vector<std::string>(keys.begin(), keys.end());
+  }
+
+  // Composite IDs: a uniform random 64 bit number, zero padded to 20 decimal
+  // digits, and one of a few record types.
+  static std::vector<std::string> ids(const long n, const long seed) {
+    std::mt19937_64 rng(seed);
+    const char *types[] = {"account", "invoice", "order", "user"};
+    std::unordered_set<std::string> keys;
+    char digits[21];
+    while ((long)keys.size() < n) {
+      snprintf(digits, sizeof(digits), "%020lu", (unsigned long)rng());
+      keys.insert(digits + std::string(":") + types[rng() % 4]);
+    }
+    return std::vector<std::string>(keys.begin(), keys.end());
+  }
+
+  // One key per line.
+  static std::vector<std::string> lines(const std::string &path) {
+    std::ifstream file{path};
+    if (!file)
+      std::cerr << "Unable to open " << path << '\n';
+    std::vector<std::string> v;
+    for (std::string line; std::getline(file, line);)
+      v.push_back(std::move(line));
+    return v;
+  }
+
+  static std::vector<std::string>
+  sorted_keys(const long n, const std::string &distribution,
+              const std::vector<std::string> &params) {
+    // datasetname - parameter
+    // str-url     - random gen seed
+    // str-id      - random gen seed
+    // str-file    - path, of a file of newline-delimited keys
+    std::vector<std::string> v;
+    if (distribution == "str-url")
+      v = urls(n, parse<long>(params[0]));
+    else if (distribution == "str-id")
+      v = ids(n, parse<long>(params[0]));
+    else if (distribution == "str-file")
+      v = lines(params[0]);
+    else
+      assert(!"No distribution found.");
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+    return v;
+  }
+
+ public:
+  StringKeys keys;
+  std::vector<std::string> permuted_keys;
+  // The sum of the offsets of the keys, which identify them.
+  unsigned long sum;
+
+  StringDataset(const long n, const std::string &distribution,
+                const std::vector<std::string> &params)
+      : keys(sorted_keys(n, distribution, params)), sum(0) {
+    permuted_keys.reserve(keys.size());
+    for (Index i = 0; i < (Index)keys.size(); i++) {
+      permuted_keys.emplace_back(keys[i]);
+      sum += keys.record(i).offset;
+    }
+    std::shuffle(permuted_keys.begin(), permuted_keys.end(),
+                 std::mt19937(42));
   }
 };
 
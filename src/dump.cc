@@ -20,6 +20,13 @@ int main(int argc, char *argv[]) {
       std::cerr << "Unable to open " << filename << std::endl;
       exit(EXIT_FAILURE);
     }
+    if (is_string_distribution(r.dataset_param.distribution)) {
+      StringDataset dataset(r.dataset_param.n, r.dataset_param.distribution,
+                            dataset_params);
+      for (Index i = 0; i < (Index)dataset.keys.size(); i++)
+        out << dataset.keys[i] << "\n";
+      continue;
+    }
     for (auto key : Dataset<8>(r.dataset_param.n,
                                r.dataset_param.distribution,
                                dataset_params).keys) {
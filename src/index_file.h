@@ -0,0 +1,217 @@
+#ifndef INDEX_FILE_H
+#define INDEX_FILE_H
+
+#include "padded_vector.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+// On-disk format of a built index, mapped to memory to search it without
+// rebuilding it. A header page is followed by named sections, each starting
+// at a page boundary so that the records keep their alignment when mapped:
+// "records" holds the record array the algorithm searches, padding included
+// (sorted, or in the layout of the algorithm such as Eytzinger), and an
+// algorithm adds a section of its own named after it with the constants it
+// computes at construction. The header records the format version, the
+// algorithm and the record size, a file written for another one is refused.
+struct IndexFileHeader {
+  static constexpr char magic_value[8] = "SRCHIDX";
+  static constexpr uint32_t current_version = 1;
+  static constexpr int max_sections = 8;
+  static constexpr uint64_t page = 4096;
+
+  struct Section {
+    char name[24];
+    uint64_t offset, bytes;
+  };
+
+  char magic[8];
+  uint32_t version;
+  uint32_t record_bytes;
+  uint32_t pad;
+  uint32_t n_sections;
+  uint64_t n_records;
+  char algorithm[32];
+  Section sections[max_sections];
+};
+static_assert(sizeof(IndexFileHeader) <= IndexFileHeader::page);
+
+// Read-only memory map of an index file. The records are a PaddedVector
+// viewing the mapping, valid as long as the IndexFile.
+template <int record_bytes> class IndexFile {
+  using Vector = PaddedVector<record_bytes>;
+  using Record = typename Vector::Record;
+  using Header = IndexFileHeader;
+
+  int fd;
+  void *addr;
+  size_t length;
+  Vector records_view;
+
+  const Header &header() const { return *(const Header *)addr; }
+
+  [[noreturn]] static void fail(const std::string &path,
+                                const std::string &what) {
+    std::cerr << "Unable to load index " << path << ": " << what << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  const Header::Section *find(const char *name) const {
+    for (uint32_t s = 0; s < header().n_sections; s++)
+      if (std::strncmp(header().sections[s].name, name,
+                       sizeof(Header::Section::name)) == 0)
+        return &header().sections[s];
+    return nullptr;
+  }
+
+  // Maps path, checks the header and that every section is in the file,
+  // returns the view of the records.
+  Vector map(const std::string &path, const char *algorithm) {
+    fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+      fail(path, "cannot open");
+    length = st.st_size;
+    if (length < Header::page)
+      fail(path, "no header");
+    // private and writable: the records are not written to, but nothing
+    // written to them could reach the file
+    addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+      fail(path, "cannot map");
+    const Header &h = header();
+    if (std::memcmp(h.magic, Header::magic_value, sizeof(h.magic)) != 0)
+      fail(path, "not an index file");
+    if (h.version != Header::current_version)
+      fail(path, "format version " + std::to_string(h.version) +
+                     ", expected " + std::to_string(Header::current_version));
+    if (std::strncmp(h.algorithm, algorithm, sizeof(h.algorithm)) != 0)
+      fail(path, std::string("index of ") + h.algorithm + ", expected " +
+                     algorithm);
+    if (h.record_bytes != record_bytes || h.pad != Vector::padding)
+      fail(path, "record size " + std::to_string(h.record_bytes));
+    if (h.n_sections > Header::max_sections)
+      fail(path, "corrupt section table");
+    for (uint32_t s = 0; s < h.n_sections; s++)
+      if (h.sections[s].offset % Header::page != 0 ||
+          h.sections[s].offset + h.sections[s].bytes > length)
+        fail(path, std::string("truncated section ") + h.sections[s].name);
+    const auto *records = find("records");
+    if (records == nullptr ||
+        records->bytes != (h.n_records + 2 * h.pad) * sizeof(Record))
+      fail(path, "no records");
+    return Vector::view((Record *)((char *)addr + records->offset),
+                        h.n_records);
+  }
+
+ public:
+  // Maps the index of algorithm in path.
+  IndexFile(const std::string &path, const char *algorithm)
+      : records_view(map(path, algorithm)) {}
+
+  ~IndexFile() {
+    munmap(addr, length);
+    close(fd);
+  }
+
+  IndexFile(const IndexFile &) = delete;
+  IndexFile &operator=(const IndexFile &) = delete;
+
+  const Vector &records() const { return records_view; }
+
+  // The section name holding a T, written by Writer::section.
+  template <class T> const T &section(const char *name) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const auto *s = find(name);
+    if (s == nullptr || s->bytes != sizeof(T)) {
+      std::cerr << "Index has no section " << name << " of " << sizeof(T)
+                << " bytes" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    return *(const T *)((const char *)addr + s->offset);
+  }
+
+  size_t bytes() const { return length; }
+
+  // Drops the pages of the file from the mapping and from the page cache, so
+  // that the next accesses read them from the device. Pages just written are
+  // written back first, dirty pages are not dropped.
+  void evict() const {
+    fdatasync(fd);
+    madvise(addr, length, MADV_DONTNEED);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  }
+
+  // Writes an index file: the records, then the sections of the algorithm,
+  // the header when it is destroyed.
+  class Writer {
+    const std::string path;
+    std::ofstream out;
+    Header h;
+
+    void add(const char *name, const void *data, const uint64_t bytes) {
+      assert(h.n_sections < Header::max_sections);
+      assert(std::strlen(name) < sizeof(Header::Section::name));
+      auto &s = h.sections[h.n_sections++];
+      // the header is zeroed, the name stays NUL terminated
+      std::memcpy(s.name, name,
+                  std::min(std::strlen(name), sizeof(s.name) - 1));
+      s.offset = out.tellp();
+      s.bytes = bytes;
+      out.write((const char *)data, bytes);
+      // the next section starts on a page boundary
+      const uint64_t end = s.offset + bytes;
+      out.seekp((end + Header::page - 1) / Header::page * Header::page);
+    }
+
+   public:
+    // An index of algorithm over records.
+    Writer(const std::string &path, const char *algorithm,
+           const Vector &records)
+        : path(path), out(path, std::ios_base::trunc | std::ios::binary),
+          h{} {
+      assert(std::strlen(algorithm) < sizeof(h.algorithm));
+      std::memcpy(h.magic, Header::magic_value, sizeof(h.magic));
+      h.version = Header::current_version;
+      h.record_bytes = record_bytes;
+      h.pad = Vector::padding;
+      h.n_records = records.size();
+      std::memcpy(h.algorithm, algorithm,
+                  std::min(std::strlen(algorithm), sizeof(h.algorithm) - 1));
+      out.seekp(Header::page);
+      add("records", records.padded_data(),
+          (records.size() + 2 * Vector::padding) * sizeof(Record));
+    }
+
+    ~Writer() {
+      out.seekp(0);
+      out.write((const char *)&h, sizeof(h));
+      out.close();
+      if (!out) {
+        std::cerr << "Unable to write " << path << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+
+    template <class T> void section(const char *name, const T &value) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      add(name, &value, sizeof(T));
+    }
+  };
+};
+
+#endif //INDEX_FILE_H
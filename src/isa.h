@@ -0,0 +1,77 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Runtime selection of the instruction set of the search kernels. The build
+// targets the baseline x86-64, the kernels are also compiled for the ISAs
+// below with ISA_TARGET_* and the widest one the CPU supports is picked once
+// at startup. The environment variable SEARCHBENCH_ISA ("base", "avx2" or
+// "avx512") lowers the choice, e.g. to compare variants on one machine.
+
+enum class Isa { Base, AVX2, AVX512 };
+
+#define ISA_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt")))
+#define ISA_TARGET_AVX512                                                      \
+  __attribute__((                                                              \
+      target("avx512f,avx512vl,avx512bw,avx512dq,avx2,bmi,bmi2,popcnt")))
+
+inline const char *isa_name(const Isa isa) {
+  switch (isa) {
+  case Isa::AVX512:
+    return "avx512";
+  case Isa::AVX2:
+    return "avx2";
+  default:
+    return "base";
+  }
+}
+
+// The widest ISA of the CPU.
+inline Isa detect_isa() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+      __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") &&
+      __builtin_cpu_supports("bmi2"))
+    return Isa::AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2"))
+    return Isa::AVX2;
+  return Isa::Base;
+}
+
+// The ISA of the kernels: detect_isa() lowered by SEARCHBENCH_ISA, resolved
+// on the first call.
+inline Isa selected_isa() {
+  static const Isa isa = [] {
+    Isa isa = detect_isa();
+    if (const char *env = std::getenv("SEARCHBENCH_ISA")) {
+      Isa wanted = !std::strcmp(env, "avx512") ? Isa::AVX512
+                   : !std::strcmp(env, "avx2") ? Isa::AVX2
+                                               : Isa::Base;
+      if (wanted > isa)
+        std::cerr << "SEARCHBENCH_ISA=" << env << " not supported, using "
+                  << isa_name(isa) << '\n';
+      else
+        isa = wanted;
+    }
+    return isa;
+  }();
+  return isa;
+}
+
+// The kernel of the selected ISA, from the variants of a dispatch table.
+template <class Kernel>
+Kernel dispatch(Kernel base, Kernel avx2, Kernel avx512) {
+  switch (selected_isa()) {
+  case Isa::AVX512:
+    return avx512;
+  case Isa::AVX2:
+    return avx2;
+  default:
+    return base;
+  }
+}
+
+#endif //ISA_H
@@ -0,0 +1,69 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Histogram of latencies in ns, for percentiles such as the p99 of single
+// lookups. Values below 16 have a bucket each, above that each power of two
+// is split into 16 linear buckets, so that a percentile is within 1/16 of
+// the value recorded. One histogram per thread, merged after the run.
+class LatencyHistogram {
+  static constexpr int sub_bits = 4, sub_buckets = 1 << sub_bits;
+
+  std::vector<uint64_t> counts;
+  uint64_t n, max_ns;
+
+  static int bucket(const uint64_t ns) {
+    if (ns < sub_buckets)
+      return ns;
+    const int e = 63 - __builtin_clzl(ns);
+    return (e - sub_bits + 1) * sub_buckets +
+           ((ns >> (e - sub_bits)) & (sub_buckets - 1));
+  }
+
+  // The smallest value of bucket b.
+  static uint64_t lowest(const int b) {
+    if (b < sub_buckets)
+      return b;
+    const int e = b / sub_buckets + sub_bits - 1;
+    return (uint64_t)(sub_buckets + b % sub_buckets) << (e - sub_bits);
+  }
+
+ public:
+  LatencyHistogram() : counts((64 - sub_bits + 1) * sub_buckets), n(0),
+                       max_ns(0) {}
+
+  void record(const uint64_t ns) {
+    counts[bucket(ns)]++;
+    n++;
+    max_ns = std::max(max_ns, ns);
+  }
+
+  void merge(const LatencyHistogram &h) {
+    for (size_t b = 0; b < counts.size(); b++)
+      counts[b] += h.counts[b];
+    n += h.n;
+    max_ns = std::max(max_ns, h.max_ns);
+  }
+
+  uint64_t count() const { return n; }
+  uint64_t max() const { return max_ns; }
+
+  // The latency that a fraction p of the values do not exceed, e.g. 0.99 for
+  // the p99: the largest value of its bucket.
+  uint64_t percentile(const double p) const {
+    const uint64_t rank = std::max<uint64_t>(1, std::ceil(p * n));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < counts.size(); b++) {
+      seen += counts[b];
+      if (seen >= rank)
+        return std::min(max_ns, lowest(b + 1) - 1);
+    }
+    return max_ns;
+  }
+};
+
+#endif //LATENCY_H
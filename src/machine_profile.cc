@@ -0,0 +1,221 @@
+#include "machine_profile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// Measures the memory hierarchy and the branch mispredict cost of the host and
+// saves them as a MachineProfile, by default to machine_profile.tsv which
+// searchbench loads. Arguments: the output file, and the largest working set
+// in MiB (default: 4 times the last level cache, at least 256 MiB).
+
+namespace {
+
+constexpr size_t line_bytes = 64;
+constexpr size_t small_page = 4096, huge_page = 2 << 20;
+
+struct Line {
+  Line *next;
+  char pad[line_bytes - sizeof(Line *)];
+};
+
+// Anonymous memory aligned to huge pages, backed by them only if huge.
+class Buffer {
+  void *map;
+  size_t length;
+
+ public:
+  char *data;
+
+  Buffer(const size_t bytes, const bool huge) : length(bytes + huge_page) {
+    map = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+      std::cerr << "Unable to allocate " << bytes << " bytes" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    data = (char *)(((uintptr_t)map + huge_page - 1) & ~(huge_page - 1));
+    madvise(data, bytes, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    std::fill(data, data + bytes, 0);
+  }
+  ~Buffer() { munmap(map, length); }
+};
+
+double seconds(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+// Links the lines at offsets into one random cycle, returns its start.
+Line *random_cycle(char *data, std::vector<size_t> offsets) {
+  std::shuffle(offsets.begin(), offsets.end(), std::mt19937_64(42));
+  for (size_t i = 0; i < offsets.size(); i++)
+    ((Line *)(data + offsets[i]))->next =
+        (Line *)(data + offsets[(i + 1) % offsets.size()]);
+  return (Line *)(data + offsets[0]);
+}
+
+// ns per load of a dependent chase through the cycle.
+double chase(Line *p, const long steps) {
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < steps; i++)
+    p = p->next;
+  double s = seconds(t0);
+  // keep the chase
+  asm volatile("" : : "r"(p));
+  return s * 1e9 / steps;
+}
+
+// Latency of random loads of the lines of a working set of the given bytes.
+double latency(const size_t bytes) {
+  Buffer buffer(bytes, true);
+  std::vector<size_t> offsets(bytes / line_bytes);
+  for (size_t i = 0; i < offsets.size(); i++)
+    offsets[i] = i * line_bytes;
+  Line *p = random_cycle(buffer.data, offsets);
+  chase(p, offsets.size());
+  return chase(p, std::max<long>(1 << 22, offsets.size()));
+}
+
+// ns per load of K chases of the same cycle, interleaved.
+template <int K> double parallel_chase(Line *start, const long n, long steps) {
+  Line *p[K];
+  p[0] = start;
+  // spread the cursors along the cycle
+  for (int k = 1; k < K; k++) {
+    p[k] = p[k - 1];
+    for (long i = 0; i < n / K; i++)
+      p[k] = p[k]->next;
+  }
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < steps; i++)
+    for (int k = 0; k < K; k++)
+      p[k] = p[k]->next;
+  double s = seconds(t0);
+  for (int k = 0; k < K; k++)
+    asm volatile("" : : "r"(p[k]));
+  return s * 1e9 / (steps * K);
+}
+
+template <size_t... K>
+std::vector<double> parallel_chases(Line *start, const long n, const long steps,
+                                    std::index_sequence<K...>) {
+  return {parallel_chase<K + 1>(start, n, steps)...};
+}
+
+// Random access time per miss with 1 to 16 misses in flight.
+std::vector<double> memory_parallelism(const size_t bytes) {
+  Buffer buffer(bytes, true);
+  std::vector<size_t> offsets(bytes / line_bytes);
+  for (size_t i = 0; i < offsets.size(); i++)
+    offsets[i] = i * line_bytes;
+  Line *p = random_cycle(buffer.data, offsets);
+  return parallel_chases(p, offsets.size(), 1 << 20,
+                         std::make_index_sequence<16>());
+}
+
+// Latency of loads of one line per page of 4 KiB over pages whose lines fit in
+// the caches but whose translations do not fit in the TLB, with 4 KiB or
+// 2 MiB pages.
+double page_latency(const bool huge) {
+  constexpr size_t pages = 1 << 14;
+  Buffer buffer(pages * small_page, huge);
+  std::vector<size_t> offsets(pages);
+  for (size_t i = 0; i < pages; i++)
+    // vary the line in the page, so that with huge pages as well the lines
+    // spread over the cache sets above the page offset
+    offsets[i] = i * small_page +
+                 ((i >> 5) % (small_page / line_bytes)) * line_bytes;
+  Line *p = random_cycle(buffer.data, offsets);
+  chase(p, pages);
+  return chase(p, 1 << 22);
+}
+
+// ns per iteration of a loop with a branch on bits.
+double branch_loop(const std::vector<uint8_t> &bits) {
+  uint64_t sum = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < 64; r++)
+    for (size_t i = 0; i < bits.size(); i++) {
+      if (bits[i]) {
+        // keeps the branch from becoming a conditional move
+        asm volatile("");
+        sum += i;
+      } else {
+        sum ^= i;
+      }
+    }
+  double s = seconds(t0);
+  asm volatile("" : : "r"(sum));
+  return s * 1e9 / (64 * bits.size());
+}
+
+// Cost of a mispredicted branch: random bits mispredict half of the time.
+double branch_mispredict() {
+  std::vector<uint8_t> bits(1 << 16);
+  std::mt19937 rng(42);
+  for (auto &b : bits)
+    b = rng() & 1;
+  double random = branch_loop(bits);
+  std::sort(bits.begin(), bits.end());
+  double sorted = branch_loop(bits);
+  return (random - sorted) * 2;
+}
+
+std::string size_name(const size_t bytes) {
+  return bytes >= (1 << 20) ? std::to_string(bytes >> 20) + "MiB"
+                            : std::to_string(bytes >> 10) + "KiB";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const std::string path = argc > 1 ? argv[1] : MachineProfile::default_path;
+  const long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE),
+             l2 = sysconf(_SC_LEVEL2_CACHE_SIZE),
+             l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  const size_t llc = std::max({l1, l2, l3, 1L << 20});
+  const size_t dram = argc > 2 ? std::stol(argv[2]) << 20
+                               : std::max<size_t>(4 * llc, 256 << 20);
+  MachineProfile profile;
+  auto record = [&](const std::string &metric, double value) {
+    profile.metrics[metric] = value;
+    std::cout << std::setw(24) << std::left << metric << value << std::endl;
+  };
+
+  // latency curve, and the latency of each cache level at half its size
+  for (size_t bytes = 16 << 10; bytes <= dram; bytes *= 2)
+    record("latency_ns_" + size_name(bytes), latency(bytes));
+  if (l1 > 0)
+    record("l1_latency_ns", latency(l1 / 2));
+  if (l2 > 0)
+    record("l2_latency_ns", latency(l2 / 2));
+  if (l3 > 0)
+    record("l3_latency_ns", latency(l3 / 2));
+  record("dram_latency_ns", latency(dram));
+
+  auto mlp = memory_parallelism(dram);
+  for (size_t k = 0; k < mlp.size(); k++) {
+    record("dram_ns_per_miss_" + std::to_string(k + 1), mlp[k]);
+    record("dram_gb_per_s_" + std::to_string(k + 1), line_bytes / mlp[k]);
+  }
+
+  const double tlb_4k = page_latency(false), tlb_2m = page_latency(true);
+  record("tlb_4k_ns", tlb_4k);
+  record("tlb_2m_ns", tlb_2m);
+  record("tlb_miss_ns", tlb_4k - tlb_2m);
+
+  record("branch_mispredict_ns", branch_mispredict());
+
+  profile.save(path);
+  std::cout << "Saved to " << path << std::endl;
+}
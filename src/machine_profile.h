@@ -0,0 +1,55 @@
+#ifndef MACHINE_PROFILE_H
+#define MACHINE_PROFILE_H
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+// The results of machine_profile: memory latencies, memory level parallelism,
+// TLB miss and branch mispredict costs of a host, to normalize the times of
+// searchbench across hosts. Saved as a file of "metric<TAB>value" lines.
+
+struct MachineProfile {
+  std::map<std::string, double> metrics;
+
+  static constexpr const char *default_path = "machine_profile.tsv";
+
+  // The profile in SEARCHBENCH_MACHINE_PROFILE, or else in default_path if
+  // it exists. Empty if there is none.
+  static MachineProfile load() {
+    const char *env = std::getenv("SEARCHBENCH_MACHINE_PROFILE");
+    return load(env != nullptr ? env : default_path);
+  }
+
+  static MachineProfile load(const std::string &path) {
+    MachineProfile profile;
+    std::ifstream file(path);
+    std::string metric;
+    double value;
+    while (file >> metric >> value)
+      profile.metrics[metric] = value;
+    return profile;
+  }
+
+  void save(const std::string &path) const {
+    std::ofstream file(path);
+    for (auto &m : metrics)
+      file << m.first << '\t' << m.second << '\n';
+  }
+
+  bool empty() const { return metrics.empty(); }
+
+  double get(const std::string &metric) const {
+    auto it = metrics.find(metric);
+    return it == metrics.end() ? NAN : it->second;
+  }
+
+  // Latency of a random access to DRAM, the unit of the DRAMLatencies
+  // column.
+  double dram_latency_ns() const { return get("dram_latency_ns"); }
+};
+
+#endif //MACHINE_PROFILE_H
@@ -0,0 +1,79 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "util.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory map of a binary key file: the number of keys (uint64_t)
+// followed by the keys, as written by convert_txt_to_bin.
+class MappedKeys {
+  int fd;
+  void *addr;
+  size_t length;
+
+ public:
+  explicit MappedKeys(const std::string &path) {
+    fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(uint64_t)) {
+      std::cerr << "Unable to open " << path << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    length = st.st_size;
+    addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      std::cerr << "Unable to map " << path << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    assert(sizeof(uint64_t) + size() * sizeof(Key) <= length);
+  }
+
+  ~MappedKeys() {
+    munmap(addr, length);
+    close(fd);
+  }
+
+  MappedKeys(const MappedKeys &) = delete;
+  MappedKeys &operator=(const MappedKeys &) = delete;
+
+  size_t size() const { return *(const uint64_t *)addr; }
+  const Key *data() const {
+    return (const Key *)((const char *)addr + sizeof(uint64_t));
+  }
+  const char *bytes() const { return (const char *)addr; }
+  const Key *begin() const { return data(); }
+  const Key *end() const { return data() + size(); }
+
+  // Drops the pages of the file from the mapping and from the page cache, so
+  // that the next accesses read them from the device.
+  void evict() const {
+    madvise(addr, length, MADV_DONTNEED);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  }
+
+  // Writes keys [begin, end) in the format MappedKeys maps.
+  template <class Iterator>
+  static void write(const std::string &path, Iterator begin, Iterator end) {
+    std::ofstream out(path, std::ios_base::trunc | std::ios::binary);
+    uint64_t size = std::distance(begin, end);
+    out.write(reinterpret_cast<const char *>(&size), sizeof(uint64_t));
+    for (; begin != end; ++begin) {
+      Key key = *begin;
+      out.write(reinterpret_cast<const char *>(&key), sizeof(Key));
+    }
+    if (!out) {
+      std::cerr << "Unable to write " << path << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+};
+
+#endif //MAPPED_FILE_H
@@ -0,0 +1,49 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <fstream>
+#include <limits>
+#include <string>
+#include <sys/resource.h>
+
+// Resident set size of the process, from /proc/self/status on Linux.
+
+// The value in KiB of a field of /proc/self/status, e.g. "VmHWM:", -1 if it
+// can not be read.
+inline long proc_status_kb(const std::string &field) {
+  std::ifstream status("/proc/self/status");
+  std::string name;
+  long kb;
+  while (status >> name) {
+    if (name == field && status >> kb)
+      return kb;
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return -1;
+}
+
+// Peak RSS in KiB.
+inline long peak_rss_kb() {
+  long kb = proc_status_kb("VmHWM:");
+  if (kb < 0) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    kb = usage.ru_maxrss;
+  }
+  return kb;
+}
+
+// Starts a measurement of the peak RSS and returns its baseline in KiB. Resets
+// the peak to the current RSS where the kernel allows it, otherwise the
+// baseline is the peak so far and lower peaks go unnoticed.
+inline long peak_rss_baseline_kb() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  if (clear_refs << "5" << std::flush) {
+    long kb = proc_status_kb("VmRSS:");
+    if (kb >= 0)
+      return kb;
+  }
+  return peak_rss_kb();
+}
+
+#endif //MEMORY_USAGE_H
@@ -2,53 +2,121 @@
 #define PADDED_VECTOR_H
 
 #include "util.h"
+#include <cstring>
 #include <limits>
 #include <vector>
 
+// The records with pad records before them holding the smallest Key and pad
+// after them holding the largest, so that searches may overshoot the ends.
+// The records are owned, or viewed in memory held elsewhere such as a mapped
+// IndexFile: a view does not copy them, and copies of it view the same ones.
 template <int record_bytes = 128, int pad = 32> class PaddedVector {
+public:
+  static constexpr int padding = pad;
   static constexpr int payload_bytes = record_bytes - sizeof(Key);
   using Payload = char[payload_bytes];
   struct Record {
     Key k;
     Payload p;
     Record() {}
-    Record(Key k) : k(k) {}
+    // The payload holds copies of the key, so that it can be verified.
+    Record(Key k) : k(k) {
+      for (int i = 0; i < payload_bytes; i += sizeof(Key))
+        std::memcpy(p + i, &k, std::min<int>(sizeof(Key), payload_bytes - i));
+    }
     bool operator<(const Record &r) const { return k < r.k; }
     operator Key () const { return k; }
   };
 
+private:
+  // empty for a view
   std::vector<Record> v;
+  // the first record of the padding, and the number of records
+  Record *base;
+  size_t n;
+
+  PaddedVector(Record *base, size_t n) : base(base), n(n) {}
 
 public:
-  PaddedVector(size_t n) : v(n + 2 * pad) {
+  PaddedVector(size_t n) : v(n + 2 * pad), base(v.data()), n(n) {
     std::fill(this->v.begin(), this->v.begin() + pad,
               std::numeric_limits<Key>::min());
     std::fill(this->v.end() - pad, this->v.end(),
               std::numeric_limits<Key>::max());
   }
-  PaddedVector(const std::vector<Key> &v) : v(v.size() + 2 * pad) {
+  PaddedVector(const std::vector<Key> &v)
+      : v(v.size() + 2 * pad), base(this->v.data()), n(v.size()) {
     std::copy(v.begin(), v.end(), this->v.begin() + pad);
     std::fill(this->v.begin(), this->v.begin() + pad,
               std::numeric_limits<Key>::min());
     std::fill(this->v.end() - pad, this->v.end(),
               std::numeric_limits<Key>::max());
   }
+  PaddedVector(const PaddedVector &o)
+      : v(o.v), base(o.is_view() ? o.base : v.data()), n(o.n) {}
+  // moving the vector keeps its buffer
+  PaddedVector(PaddedVector &&o) : v(std::move(o.v)), base(o.base), n(o.n) {}
+  PaddedVector &operator=(const PaddedVector &o) {
+    v = o.v;
+    base = o.is_view() ? o.base : v.data();
+    n = o.n;
+    return *this;
+  }
+  PaddedVector &operator=(PaddedVector &&o) {
+    v = std::move(o.v);
+    base = o.base;
+    n = o.n;
+    return *this;
+  }
+
+  // The n records at padded + pad, with their padding before and after them,
+  // e.g. in a mapped file. The memory must outlive the view and its copies.
+  static PaddedVector view(Record *padded, size_t n) {
+    return PaddedVector(padded, n);
+  }
+  bool is_view() const { return v.empty() && base != nullptr; }
+  // A copy that owns its records, also of a view.
+  PaddedVector owned_copy() const {
+    PaddedVector copy(n);
+    std::copy(base, base + n + 2 * pad, copy.v.begin());
+    return copy;
+  }
+
   Key &operator[](long ix) {
     // allow some inaccuracy to reduce needed precision
     assert(ix >= -pad);
-    assert(ix <= size() + pad);
-    return v[ix + pad].k;
+    assert(ix <= (long)size() + pad);
+    return base[ix + pad].k;
   }
   const Key &operator[](long ix) const {
     // allow some inaccuracy to reduce needed precision
     assert(ix >= -pad);
-    assert(ix <= size() + pad);
-    return v[ix + pad].k;
+    assert(ix <= (long)size() + pad);
+    return base[ix + pad].k;
+  }
+  Record &record(long ix) {
+    assert(ix >= -pad);
+    assert(ix <= (long)size() + pad);
+    return base[ix + pad];
+  }
+  const Record &record(long ix) const {
+    assert(ix >= -pad);
+    assert(ix <= (long)size() + pad);
+    return base[ix + pad];
+  }
+  Record *begin() { return base + pad; }
+  Record *end() { return base + pad + n; };
+  const Record *begin() const { return base + pad; }
+  const Record *end() const { return base + pad + n; };
+  const Key *cbegin() const { return &base[pad].k; }
+  // The records from the first of the padding, as laid out in memory.
+  const Record *padded_data() const { return base; }
+  size_t size() const { return n; }
+  // Bytes of the records, padding included, allocated or viewed.
+  size_t bytes() const {
+    return is_view() ? (n + 2 * pad) * sizeof(Record)
+                     : v.capacity() * sizeof(Record);
   }
-  auto begin() { return v.begin() + pad; }
-  auto end() { return v.end() - pad; };
-  const Key *cbegin() const { return v.data() + pad; }
-  size_t size() const { return v.size() - 2 * pad; }
   Key back() const { return (*this)[size() - 1]; }
   auto get_pad() const { return pad; }
 };
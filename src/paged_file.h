@@ -0,0 +1,171 @@
+#ifndef PAGED_FILE_H
+#define PAGED_FILE_H
+
+#include "mapped_file.h"
+#include "util.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Sorted keys that stay in a key file (the format of MappedKeys), accessed a
+// page at a time. A storage hands out the keys of a page with keys(page) and
+// counts the pages touched, consecutive accesses to the same page are one
+// touch. Storages are not thread safe, each thread opens its own.
+
+constexpr Index page_bytes = 4096;
+// bytes before the first key, its count
+constexpr Index header_bytes = sizeof(uint64_t);
+
+class PagedKeysBase {
+ protected:
+  Index n;
+  Index last_page;
+
+  void touch(const Index page) {
+    if (page != last_page) {
+      touches++;
+      last_page = page;
+    }
+  }
+
+ public:
+  // pages touched, and pages read from the file (by PreadPages, the reads of
+  // the kernel for MmapPages are not counted)
+  uint64_t touches, reads;
+
+  PagedKeysBase() : n(0), last_page(-1), touches(0), reads(0) {}
+
+  Index size() const { return n; }
+  Index pages() const { return page_of(n - 1) + 1; }
+
+  // The page holding key i, and the first key of page p.
+  static Index page_of(const Index i) {
+    return (header_bytes + i * (Index)sizeof(Key)) / page_bytes;
+  }
+  static Index page_begin(const Index p) {
+    return std::max<Index>(0,
+                           (p * page_bytes - header_bytes) / (Index)sizeof(Key));
+  }
+  Index page_end(const Index p) const { return std::min(n, page_begin(p + 1)); }
+  // Offset of key page_begin(p) in page p.
+  static Index page_offset(const Index p) {
+    return header_bytes + page_begin(p) * (Index)sizeof(Key) - p * page_bytes;
+  }
+
+  // Key i, by the keys(page) of the storage.
+  template <class Storage> static Key key(Storage &s, const Index i) {
+    const Index p = page_of(i);
+    return s.keys(p)[i - page_begin(p)];
+  }
+};
+
+// The file mapped to memory, the kernel reads the pages it misses.
+class MmapPages : public PagedKeysBase {
+  MappedKeys file;
+
+ public:
+  explicit MmapPages(const std::string &path) : file(path) {
+    n = file.size();
+  }
+
+  // keys(p)[i - page_begin(p)] is key i of page p.
+  const Key *keys(const Index p) {
+    touch(p);
+    return file.data() + page_begin(p);
+  }
+
+  Key operator[](const Index i) { return key(*this, i); }
+
+  void evict() {
+    file.evict();
+    last_page = -1;
+  }
+};
+
+// Reads pages with pread, optionally with O_DIRECT to bypass the page cache
+// of the kernel, into a small direct mapped cache of its own. On file systems
+// without O_DIRECT, such as tmpfs, the pages are read buffered and dropped
+// from the page cache after each read instead.
+class PreadPages : public PagedKeysBase {
+  struct FreeDeleter {
+    void operator()(void *p) const { free(p); }
+  };
+
+  int fd;
+  // opened with O_DIRECT, and buffered reads followed by POSIX_FADV_DONTNEED
+  bool direct_io, drop_pages;
+  Index cache_pages;
+  std::unique_ptr<char, FreeDeleter> buffer;
+  std::vector<Index> tags;
+
+  ssize_t read_page(const Index p, char *page) {
+    const ssize_t bytes = ::pread(fd, page, page_bytes, p * page_bytes);
+    if (drop_pages)
+      posix_fadvise(fd, p * page_bytes, page_bytes, POSIX_FADV_DONTNEED);
+    return bytes;
+  }
+
+ public:
+  PreadPages(const std::string &path, const bool direct,
+             const Index cache_pages = 64)
+      : direct_io(direct), drop_pages(false), cache_pages(cache_pages),
+        buffer((char *)aligned_alloc(page_bytes, cache_pages * page_bytes)),
+        tags(cache_pages, -1) {
+    fd = open(path.c_str(), O_RDONLY | (direct ? O_DIRECT : 0));
+    if (direct && fd < 0 && errno == EINVAL) {
+      std::cerr << "No O_DIRECT for " << path
+                << ", reading it buffered and dropping the pages read"
+                << std::endl;
+      fd = open(path.c_str(), O_RDONLY);
+      direct_io = false;
+      drop_pages = true;
+    }
+    uint64_t size;
+    if (fd < 0 || read_page(0, buffer.get()) < (ssize_t)sizeof(uint64_t)) {
+      std::cerr << "Unable to open " << path << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::memcpy(&size, buffer.get(), sizeof(size));
+    n = size;
+  }
+
+  ~PreadPages() { close(fd); }
+
+  PreadPages(const PreadPages &) = delete;
+  PreadPages &operator=(const PreadPages &) = delete;
+
+  const Key *keys(const Index p) {
+    touch(p);
+    char *page = buffer.get() + (p % cache_pages) * page_bytes;
+    if (tags[p % cache_pages] != p) {
+      reads++;
+      // the last page can be short
+      if (read_page(p, page) <= 0) {
+        std::cerr << "Unable to read page " << p << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      tags[p % cache_pages] = p;
+    }
+    return (const Key *)(page + page_offset(p));
+  }
+
+  Key operator[](const Index i) { return key(*this, i); }
+
+  // Empties the cache of the storage, and without O_DIRECT drops the pages
+  // of the file from the page cache as MappedKeys::evict does.
+  void evict() {
+    std::fill(tags.begin(), tags.end(), -1);
+    last_page = -1;
+    if (!direct_io)
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  }
+};
+
+#endif //PAGED_FILE_H
@@ -0,0 +1,75 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include "padded_vector.h"
+#include "util.h"
+
+#include <cstring>
+#include <x86intrin.h>
+
+// Ways for the benchmark to use a record after finding it. Each returns a
+// checksum of what it touched, out is a buffer of payload_bytes when the
+// payload is copied.
+enum class Touch { Key, Read, Checksum, Copy, CopyNT };
+
+template <int record_bytes> struct PayloadTouch {
+  using Vector = PaddedVector<record_bytes>;
+  using Record = typename Vector::Record;
+  static constexpr int payload_bytes = Vector::payload_bytes;
+
+  // Sum of the 8 byte words of the first `bytes` of the payload, the bytes
+  // after the last whole word are read as one zero extended word.
+  static __attribute__((always_inline)) uint64_t
+  read(const Record &r, const int bytes) {
+    uint64_t sum = 0;
+    int i = 0;
+    for (; i + (int)sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, r.p + i, sizeof(word));
+      sum += word;
+    }
+    if (i < bytes) {
+      uint64_t word = 0;
+      std::memcpy(&word, r.p + i, bytes - i);
+      sum += word;
+    }
+    return sum;
+  }
+
+  static __attribute__((always_inline)) void copy(const Record &r, char *out) {
+    std::memcpy(out, r.p, payload_bytes);
+  }
+
+  // Copy with non-temporal stores, that bypass the caches.
+  static __attribute__((always_inline)) void copy_nt(const Record &r,
+                                                     char *out) {
+    for (int i = 0; i + (int)sizeof(long long) <= payload_bytes;
+         i += sizeof(long long)) {
+      long long word;
+      std::memcpy(&word, r.p + i, sizeof(word));
+      _mm_stream_si64((long long *)(out + i), word);
+    }
+  }
+
+  template <Touch touch>
+  static __attribute__((always_inline)) uint64_t
+  apply(const Record &r, const int bytes, char *out) {
+    switch (touch) {
+    case Touch::Key:
+      return r.k;
+    case Touch::Read:
+      return r.k + read(r, bytes);
+    case Touch::Checksum:
+      return r.k + read(r, payload_bytes);
+    case Touch::Copy:
+      copy(r, out);
+      return r.k;
+    case Touch::CopyNT:
+      copy_nt(r, out);
+      return r.k;
+    }
+    return 0;
+  }
+};
+
+#endif //PAYLOAD_H
@@ -0,0 +1,84 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <memory>
+#include <omp.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+// A hardware event counted for the thread that opens it, through
+// perf_event_open. Where the kernel or the machine does not provide the event
+// (containers, VMs without a PMU, perf_event_paranoid) the counter is not
+// available and reads 0.
+class PerfCounter {
+  int fd;
+
+ public:
+  explicit PerfCounter(const uint64_t config = PERF_COUNT_HW_CACHE_MISSES) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  ~PerfCounter() {
+    if (fd >= 0)
+      close(fd);
+  }
+
+  PerfCounter(const PerfCounter &) = delete;
+  PerfCounter &operator=(const PerfCounter &) = delete;
+
+  bool available() const { return fd >= 0; }
+
+  uint64_t read() const {
+    uint64_t count = 0;
+    if (fd >= 0 && ::read(fd, &count, sizeof(count)) != sizeof(count))
+      count = 0;
+    return count;
+  }
+};
+
+// Last level cache misses of the threads of an OpenMP team of n_thds, each
+// thread opens its counter. The counters follow the threads into the later
+// parallel regions of the same size, which reuse them.
+class TeamCacheMisses {
+  std::vector<std::unique_ptr<PerfCounter>> counters;
+  std::vector<uint64_t> start;
+
+ public:
+  explicit TeamCacheMisses(const int n_thds)
+      : counters(n_thds), start(n_thds, 0) {
+#pragma omp parallel num_threads(n_thds)
+    {
+      const int tid = omp_get_thread_num();
+      counters[tid] = std::make_unique<PerfCounter>();
+      start[tid] = counters[tid]->read();
+    }
+  }
+
+  bool available() const {
+    for (auto &c : counters)
+      if (!c->available())
+        return false;
+    return true;
+  }
+
+  // Misses of all threads since the construction.
+  uint64_t read() const {
+    uint64_t misses = 0;
+    for (size_t t = 0; t < counters.size(); t++)
+      misses += counters[t]->read() - start[t];
+    return misses;
+  }
+};
+
+#endif //PERF_COUNTERS_H
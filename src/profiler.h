@@ -0,0 +1,86 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+
+// Control of `perf record --control=fifo:ctl[,ack]`, started with the events
+// disabled (-D -1) so that only the timed loops are profiled. The fifos are
+// passed in the environment variables SEARCHBENCH_PERF_CTL and
+// SEARCHBENCH_PERF_ACK (optional). Each enable and disable is marked on
+// stderr with the run and the CLOCK_MONOTONIC time, to slice a profile of
+// several runs with `perf record -k CLOCK_MONOTONIC` and `perf script --time`.
+// Without SEARCHBENCH_PERF_CTL nothing is done.
+class PerfControl {
+  int ctl_fd, ack_fd;
+
+  PerfControl() : ctl_fd(-1), ack_fd(-1) {
+    if (const char *ctl = std::getenv("SEARCHBENCH_PERF_CTL")) {
+      ctl_fd = open(ctl, O_WRONLY | O_CLOEXEC);
+      if (ctl_fd < 0)
+        std::cerr << "Unable to open " << ctl << ", not profiling\n";
+    }
+    if (const char *ack = std::getenv("SEARCHBENCH_PERF_ACK"))
+      if (ctl_fd >= 0)
+        ack_fd = open(ack, O_RDONLY | O_CLOEXEC);
+  }
+
+  // Sends a command and waits for perf to acknowledge it.
+  void command(const char *cmd) {
+    if (write(ctl_fd, cmd, std::strlen(cmd)) < 0)
+      std::cerr << "perf control: " << std::strerror(errno) << '\n';
+    if (ack_fd >= 0) {
+      char ack[5];
+      if (read(ack_fd, ack, sizeof(ack)) <= 0)
+        std::cerr << "perf control: no ack\n";
+    }
+  }
+
+  static double now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+
+ public:
+  ~PerfControl() {
+    if (ctl_fd >= 0)
+      close(ctl_fd);
+    if (ack_fd >= 0)
+      close(ack_fd);
+  }
+
+  static PerfControl &get() {
+    static PerfControl control;
+    return control;
+  }
+
+  bool active() const { return ctl_fd >= 0; }
+
+  // Starts and stops profiling the region of run.
+  void enable(const std::string &run) {
+    if (!active())
+      return;
+    std::cerr << std::fixed << "perf marker: enable " << now() << ' ' << run
+              << '\n'
+              << std::defaultfloat;
+    command("enable\n");
+  }
+
+  void disable(const std::string &run) {
+    if (!active())
+      return;
+    command("disable\n");
+    std::cerr << std::fixed << "perf marker: disable " << now() << ' ' << run
+              << '\n'
+              << std::defaultfloat;
+  }
+};
+
+#endif //PROFILER_H
@@ -0,0 +1,79 @@
+#ifndef QUERY_SOURCE_H
+#define QUERY_SOURCE_H
+
+#include "mapped_file.h"
+#include "util.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// The probe keys of a run. By default the keys of the dataset in random
+// order (Dataset::permuted_keys), or a recorded trace of probe keys mapped
+// from a binary key file in the format of txt_to_bin, which can be much
+// larger than the dataset and hold keys absent from it.
+//
+// The queries are searched in subsets of sample_size keys. Every thread
+// searches all the synthesized subsets, while the subsets of a trace are
+// split between the threads: in contiguous chunks, as a service sharding
+// its log by time, or round robin.
+class QuerySource {
+ public:
+  enum class Split { All, Chunked, RoundRobin };
+
+ private:
+  std::unique_ptr<MappedKeys> trace;
+  const Key *keys;
+  size_t n;
+  Split split;
+
+ public:
+  explicit QuerySource(const std::vector<Key> &permuted_keys)
+      : keys(permuted_keys.data()), n(permuted_keys.size()),
+        split(Split::All) {}
+
+  // The trace of spec "path" or "path,chunked" (default) or "path,rr".
+  explicit QuerySource(const std::string &spec) {
+    const auto comma = spec.find(',');
+    const std::string mode =
+        comma == std::string::npos ? "chunked" : spec.substr(comma + 1);
+    trace = std::make_unique<MappedKeys>(spec.substr(0, comma));
+    keys = trace->data();
+    n = trace->size();
+    if (mode == "rr")
+      split = Split::RoundRobin;
+    else if (mode == "chunked")
+      split = Split::Chunked;
+    else {
+      std::cerr << "Unknown split of queries " << mode << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  bool is_trace() const { return split != Split::All; }
+  const Key *data() const { return keys; }
+  size_t size() const { return n; }
+  const char *split_name() const {
+    return split == Split::Chunked      ? "chunked"
+           : split == Split::RoundRobin ? "round robin"
+                                        : "all";
+  }
+
+  // The subsets of a trace that thread tid of n_thds searches, in order.
+  std::vector<int> subsets_of(const int tid, const int n_thds,
+                              const int n_subsets) const {
+    std::vector<int> subsets;
+    if (split == Split::RoundRobin) {
+      for (int s = tid; s < n_subsets; s += n_thds)
+        subsets.push_back(s);
+    } else {
+      const long begin = (long)n_subsets * tid / n_thds,
+                 end = (long)n_subsets * (tid + 1) / n_thds;
+      for (long s = begin; s < end; s++)
+        subsets.push_back(s);
+    }
+    return subsets;
+  }
+};
+
+#endif //QUERY_SOURCE_H
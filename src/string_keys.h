@@ -0,0 +1,120 @@
+#ifndef STRING_KEYS_H
+#define STRING_KEYS_H
+
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sorted variable-length keys, such as URLs or composite IDs. The bytes of
+// all keys are in one buffer, each record holds the offset and length of its
+// key and, inline, the 8 bytes that follow the prefix common to all keys,
+// big endian and zero padded so that comparing prefixes as unsigned integers
+// orders them like the keys. Searches compare the prefixes and only read the
+// bytes of a key when the prefixes tie.
+class StringKeys {
+ public:
+  struct Record {
+    uint64_t prefix;
+    uint64_t offset : 40, length : 24;
+  };
+
+  // A key to search for: its prefix and on which side of the common prefix
+  // it falls, -1 before all keys, 1 after all keys, 0 if it has it.
+  struct Probe {
+    std::string_view x;
+    uint64_t prefix;
+    int side;
+  };
+
+ private:
+  // shared by the copies of the records in other layouts
+  std::shared_ptr<const std::string> bytes;
+  std::vector<Record> v;
+  size_t common;
+
+ public:
+  // The 8 bytes of s from position from on, as a big endian integer.
+  static uint64_t load_prefix(const std::string_view s, const size_t from) {
+    unsigned char b[sizeof(uint64_t)] = {};
+    if (from < s.size())
+      std::memcpy(b, s.data() + from,
+                  std::min(sizeof(uint64_t), s.size() - from));
+    uint64_t p;
+    std::memcpy(&p, b, sizeof(p));
+    return __builtin_bswap64(p);
+  }
+
+  // From sorted distinct keys.
+  StringKeys(const std::vector<std::string> &sorted) : v(sorted.size()) {
+    assert(std::is_sorted(sorted.begin(), sorted.end()));
+    std::string all;
+    size_t total = 0;
+    for (auto &s : sorted)
+      total += s.size();
+    all.reserve(total);
+    common = sorted.empty() ? 0 : sorted.front().size();
+    for (size_t i = 0; i < sorted.size(); i++) {
+      const std::string &s = sorted[i];
+      assert(s.size() < (1UL << 24));
+      v[i].offset = all.size();
+      v[i].length = s.size();
+      all += s;
+      // the common prefix of sorted keys is that of the first and last
+      if (i + 1 == sorted.size())
+        common = std::mismatch(sorted.front().begin(),
+                               sorted.front().begin() +
+                                   std::min(sorted.front().size(), s.size()),
+                               s.begin())
+                     .first -
+                 sorted.front().begin();
+    }
+    bytes = std::make_shared<const std::string>(std::move(all));
+    for (size_t i = 0; i < sorted.size(); i++)
+      v[i].prefix = load_prefix(sorted[i], common);
+  }
+
+  size_t size() const { return v.size(); }
+  Record &record(const Index i) { return v[i]; }
+  const Record &record(const Index i) const { return v[i]; }
+  const Record *data() const { return v.data(); }
+
+  std::string_view key(const Record &r) const {
+    return std::string_view(bytes->data() + r.offset, r.length);
+  }
+  std::string_view operator[](const Index i) const { return key(v[i]); }
+
+  // The prefix common to all keys, skipped by the inline prefixes.
+  std::string_view common_prefix() const {
+    return v.empty() ? std::string_view() : key(v[0]).substr(0, common);
+  }
+
+  Probe probe(const std::string_view x) const {
+    const std::string_view c = common_prefix();
+    const int side = x.substr(0, c.size()) == c ? 0 : x < c ? -1 : 1;
+    return {x, load_prefix(x, c.size()), side};
+  }
+
+  // Compares the key of r with the probe, <0, 0 or >0 like memcmp.
+  __attribute__((always_inline)) int compare(const Record &r,
+                                             const Probe &q) const {
+    if (r.prefix != q.prefix)
+      return r.prefix < q.prefix ? -1 : 1;
+    return key(r).substr(common).compare(q.x.substr(common));
+  }
+
+  __attribute__((always_inline)) bool less(const Record &r,
+                                           const Probe &q) const {
+    return r.prefix != q.prefix ? r.prefix < q.prefix : compare(r, q) < 0;
+  }
+
+  // Bytes of the records and of the keys.
+  size_t bytes_of_records() const { return v.capacity() * sizeof(Record); }
+  size_t bytes_of_keys() const { return bytes->capacity(); }
+};
+
+#endif //STRING_KEYS_H